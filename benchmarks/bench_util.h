@@ -0,0 +1,31 @@
+#pragma once
+
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Pin the calling thread to a core so cross-thread benchmarks measure a fixed core pair.
+// Pinning is skipped if the core does not exist or the platform has no affinity support.
+inline void PinThisThread(unsigned int core)
+{
+#if defined(__linux__)
+    if (core >= std::thread::hardware_concurrency())
+    {
+        return;
+    }
+
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(core, &cpuSet);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+#else
+    (void)core;
+#endif
+}
+
+// Core numbers used for the consumer (benchmark) thread and the producer thread.
+inline constexpr unsigned int consumerCore = 0;
+inline constexpr unsigned int producerCore = 1;
@@ -0,0 +1,430 @@
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "bench_util.h"
+#include "no_copy_ring_fifo.h"
+#include "mpsc_no_copy_ring_fifo.h"
+
+using namespace FifoTemplates;
+
+namespace
+{
+    struct CacheLineElement
+    {
+        uint8_t bytes[64];
+    };
+
+    // Copy a source buffer into a reserved block, one span at a time.
+    template <typename T> void CopyIn(DataBlock<T>& dataBlock, const T* source)
+    {
+        for (auto& span : dataBlock.spans)
+        {
+            std::memcpy(span.data(), source, span.size_bytes());
+            source += span.size();
+        }
+    }
+
+    // Copy a read block out to a destination buffer, one span at a time.
+    template <typename T> void CopyOut(const DataBlock<T>& dataBlock, T* destination)
+    {
+        for (auto& span : dataBlock.spans)
+        {
+            std::memcpy(destination, span.data(), span.size_bytes());
+            destination += span.size();
+        }
+    }
+
+    // Baseline for BM_SpscCursorTraffic - the SPSC cursor protocol with both cursors on one cache line and no cached
+    // copies, so every call loads the line the other thread is writing.
+    class PackedSpscCursors
+    {
+    public:
+        PackedSpscCursors(size_t size) : _size(size) {}
+
+        bool TryReserveCommit(size_t size)
+        {
+            const size_t writeCursor = _writeCursor.load(std::memory_order_relaxed);
+            if (size > (_size - (writeCursor - _readCursor.load(std::memory_order_acquire))))
+            {
+                return false;
+            }
+
+            _writeCursor.store((writeCursor + size), std::memory_order_release);
+
+            return true;
+        }
+
+        bool TryReadRelease(size_t size)
+        {
+            const size_t readCursor = _readCursor.load(std::memory_order_relaxed);
+            if (size > (_writeCursor.load(std::memory_order_acquire) - readCursor))
+            {
+                return false;
+            }
+
+            _readCursor.store((readCursor + size), std::memory_order_release);
+
+            return true;
+        }
+
+    private:
+        size_t _size;
+        std::atomic<size_t> _writeCursor = 0;
+        std::atomic<size_t> _readCursor = 0;
+    };
+
+    // SpscNoCopyRingFifo with the same interface as PackedSpscCursors.  The polling wait strategy keeps the notify
+    // fence out of the comparison.
+    class SpscFifoCursors
+    {
+    public:
+        SpscFifoCursors(size_t size) : _fifo(size) {}
+
+        bool TryReserveCommit(size_t size)
+        {
+            if (!_fifo.TryReserve(size))
+            {
+                return false;
+            }
+
+            _fifo.Commit(size);
+
+            return true;
+        }
+
+        bool TryReadRelease(size_t size)
+        {
+            if (!_fifo.TryPeekBlock(size))
+            {
+                return false;
+            }
+
+            _fifo.Release(size);
+
+            return true;
+        }
+
+    private:
+        SpscNoCopyRingFifo<uint8_t, DefaultErrorPolicy, BusySpinWait> _fifo;
+    };
+}
+
+// Single thread reserve/commit/read round trip with no data movement.
+// Arguments: FIFO capacity, block size.
+template <typename Fifo> void BM_RoundTrip(benchmark::State& state)
+{
+    const size_t capacity = static_cast<size_t>(state.range(0));
+    const size_t blockSize = static_cast<size_t>(state.range(1));
+
+    Fifo fifo(capacity);
+
+    for (auto _ : state)
+    {
+        auto inDataBlock = fifo.Reserve(blockSize);
+        benchmark::DoNotOptimize(inDataBlock);
+        fifo.Commit(blockSize);
+
+        auto outDataBlock = fifo.ReadBlock(blockSize);
+        benchmark::DoNotOptimize(outDataBlock);
+    }
+
+    state.SetItemsProcessed(state.iterations() * blockSize);
+}
+
+// Construction cost of a large byte FIFO, which shows the cost of value-initialising the buffer up front.
+// Arguments: FIFO capacity.
+template <typename Fifo> void BM_Construct(benchmark::State& state)
+{
+    const size_t capacity = static_cast<size_t>(state.range(0));
+
+    for (auto _ : state)
+    {
+        Fifo fifo(capacity);
+        auto dataBlock = fifo.Reserve(1);
+        benchmark::DoNotOptimize(dataBlock);
+    }
+
+    state.SetBytesProcessed(state.iterations() * capacity);
+}
+
+// Single thread round trip that copies data in and out, with block sizes chosen so most blocks wrap.
+// Arguments: FIFO capacity, block size.
+template <typename Fifo, typename T> void BM_WraparoundCopy(benchmark::State& state)
+{
+    const size_t capacity = static_cast<size_t>(state.range(0));
+    const size_t blockSize = static_cast<size_t>(state.range(1));
+
+    Fifo fifo(capacity);
+    std::vector<T> source(blockSize);
+    std::vector<T> destination(blockSize);
+    int64_t splitCount = 0;
+
+    for (auto _ : state)
+    {
+        auto inDataBlock = fifo.Reserve(blockSize);
+        CopyIn(inDataBlock, source.data());
+        fifo.Commit(blockSize);
+
+        auto outDataBlock = fifo.ReadBlock(blockSize);
+        CopyOut(outDataBlock, destination.data());
+        splitCount += outDataBlock.isSplit() ? 1 : 0;
+
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(state.iterations() * blockSize * sizeof(T));
+    state.counters["splitRatio"] = benchmark::Counter(
+        static_cast<double>(splitCount),
+        benchmark::Counter::kAvgIterations
+        );
+}
+
+// Cross-thread throughput through the SPSC FIFO.  The producer thread streams blocks while the benchmark thread
+// consumes them, each pinned to its own core.
+// Arguments: FIFO capacity, block size.
+template <typename T> void BM_SpscThroughput(benchmark::State& state)
+{
+    const size_t capacity = static_cast<size_t>(state.range(0));
+    const size_t blockSize = static_cast<size_t>(state.range(1));
+
+    SpscNoCopyRingFifo<T> fifo(capacity);
+    std::atomic<bool> running = true;
+
+    PinThisThread(consumerCore);
+
+    std::thread producer([&]()
+        {
+            PinThisThread(producerCore);
+
+            while (running.load(std::memory_order_relaxed))
+            {
+                auto dataBlock = fifo.TryReserve(blockSize);
+                if (!dataBlock)
+                {
+                    continue;
+                }
+
+                benchmark::DoNotOptimize(*dataBlock);
+                fifo.Commit(blockSize);
+            }
+        });
+
+    for (auto _ : state)
+    {
+        while (!fifo.TryPeekBlock(blockSize))
+        {
+        }
+
+        fifo.Release(blockSize);
+    }
+
+    running = false;
+    producer.join();
+
+    state.SetItemsProcessed(state.iterations() * blockSize);
+}
+
+// Cross-thread throughput through the MPSC FIFO with several producer threads, each pinned to its own core after
+// the consumer's.
+// Arguments: FIFO capacity, block size, producer count.
+template <typename T> void BM_MpscThroughput(benchmark::State& state)
+{
+    const size_t capacity = static_cast<size_t>(state.range(0));
+    const size_t blockSize = static_cast<size_t>(state.range(1));
+    const unsigned int producerCount = static_cast<unsigned int>(state.range(2));
+
+    MpscNoCopyRingFifo<T> fifo(capacity);
+    std::atomic<bool> running = true;
+
+    PinThisThread(consumerCore);
+
+    std::vector<std::thread> producers;
+    for (unsigned int producer = 0; producer < producerCount; producer++)
+    {
+        producers.emplace_back([&, producer]()
+            {
+                PinThisThread(producerCore + producer);
+
+                while (running.load(std::memory_order_relaxed))
+                {
+                    auto dataBlock = fifo.TryReserve(blockSize);
+                    if (!dataBlock)
+                    {
+                        continue;
+                    }
+
+                    benchmark::DoNotOptimize(*dataBlock);
+                    fifo.Commit(*dataBlock);
+                }
+            });
+    }
+
+    for (auto _ : state)
+    {
+        while (!fifo.TryPeekBlock(blockSize))
+        {
+        }
+
+        fifo.Release(blockSize);
+    }
+
+    running = false;
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+
+    state.SetItemsProcessed(state.iterations() * blockSize);
+}
+
+// Cross-thread cursor traffic with no data movement, comparing the FIFO's cache line layout and cached cursors
+// against the packed baseline.  With the threads on separate cores the baseline moves the shared line on nearly every
+// call, while the FIFO only does so when its cached view of the other cursor runs out.
+// Arguments: FIFO capacity, block size.
+template <typename Cursors> void BM_SpscCursorTraffic(benchmark::State& state)
+{
+    const size_t capacity = static_cast<size_t>(state.range(0));
+    const size_t blockSize = static_cast<size_t>(state.range(1));
+
+    Cursors cursors(capacity);
+    std::atomic<bool> running = true;
+
+    PinThisThread(consumerCore);
+
+    std::thread producer([&]()
+        {
+            PinThisThread(producerCore);
+
+            while (running.load(std::memory_order_relaxed))
+            {
+                cursors.TryReserveCommit(blockSize);
+            }
+        });
+
+    for (auto _ : state)
+    {
+        while (!cursors.TryReadRelease(blockSize))
+        {
+        }
+    }
+
+    running = false;
+    producer.join();
+
+    state.SetItemsProcessed(state.iterations() * blockSize);
+}
+
+// Round trip latency between two threads through a request FIFO and a reply FIFO, both using the blocking calls
+// with the given wait strategy.  The benchmark reports wall time and the CPU time of the whole process, so the CPU
+// column shows how much CPU the two waiting threads burn per round trip.
+template <typename WaitStrategy> void BM_WaitPingPong(benchmark::State& state)
+{
+    typedef SpscNoCopyRingFifo<uint64_t, DefaultErrorPolicy, WaitStrategy> PingPongFifo;
+
+    PingPongFifo requests(64);
+    PingPongFifo replies(64);
+
+    PinThisThread(consumerCore);
+
+    // The echo thread returns each request value, and stops at a zero.
+    std::thread echo([&]()
+        {
+            PinThisThread(producerCore);
+
+            for (;;)
+            {
+                const uint64_t value = requests.ReadBlock(1, waitForever).spans[0][0];
+                if (value == 0)
+                {
+                    break;
+                }
+
+                replies.Reserve(1, waitForever).spans[0][0] = value;
+                replies.Commit(1);
+            }
+        });
+
+    uint64_t value = 0;
+    for (auto _ : state)
+    {
+        requests.Reserve(1, waitForever).spans[0][0] = ++value;
+        requests.Commit(1);
+
+        benchmark::DoNotOptimize(replies.ReadBlock(1, waitForever).spans[0][0]);
+    }
+
+    requests.Reserve(1, waitForever).spans[0][0] = 0;
+    requests.Commit(1);
+    echo.join();
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_TEMPLATE(BM_RoundTrip, NoCopyRingFifo<uint8_t>)
+    ->ArgsProduct({ { 4096, 1 << 20 }, { 1, 16, 256 } });
+BENCHMARK_TEMPLATE(BM_RoundTrip, NoCopyRingFifo<uint32_t>)
+    ->ArgsProduct({ { 4096, 1 << 20 }, { 1, 16, 256 } });
+BENCHMARK_TEMPLATE(BM_RoundTrip, NoCopyRingFifo<CacheLineElement>)
+    ->ArgsProduct({ { 4096 }, { 1, 16, 256 } });
+BENCHMARK_TEMPLATE(BM_RoundTrip, NoCopyRingFifo<uint8_t, VectorStorage<uint8_t>, PowerOfTwoCapacity>)
+    ->ArgsProduct({ { 4096, 1 << 20 }, { 1, 16, 256 } });
+BENCHMARK_TEMPLATE(BM_RoundTrip, SpscNoCopyRingFifo<uint8_t>)
+    ->ArgsProduct({ { 4096, 1 << 20 }, { 1, 16, 256 } });
+BENCHMARK_TEMPLATE(BM_RoundTrip, SpscNoCopyRingFifo<uint8_t, DefaultErrorPolicy, BusySpinWait>)
+    ->ArgsProduct({ { 4096 }, { 1, 16, 256 } });
+
+// Compile-time capacity against the runtime sizes above, for a power of two size and a non power of two size.
+BENCHMARK_TEMPLATE(BM_RoundTrip, NoCopyRingFifo<uint8_t>)
+    ->ArgsProduct({ { 4000 }, { 1, 16, 256 } });
+BENCHMARK_TEMPLATE(BM_RoundTrip, FixedNoCopyRingFifo<uint8_t, 4096>)
+    ->ArgsProduct({ { 4096 }, { 1, 16, 256 } });
+BENCHMARK_TEMPLATE(BM_RoundTrip, FixedNoCopyRingFifo<uint8_t, 4000>)
+    ->ArgsProduct({ { 4000 }, { 1, 16, 256 } });
+
+BENCHMARK_TEMPLATE(BM_Construct, NoCopyRingFifo<uint8_t>)
+    ->Arg(1 << 28)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Construct, NoCopyRingFifo<uint8_t, UninitializedStorage<uint8_t>>)
+    ->Arg(1 << 28)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_TEMPLATE(BM_WraparoundCopy, NoCopyRingFifo<uint8_t>, uint8_t)
+    ->ArgsProduct({ { 4096 }, { 1000, 3000 } });
+BENCHMARK_TEMPLATE(BM_WraparoundCopy, NoCopyRingFifo<uint32_t>, uint32_t)
+    ->ArgsProduct({ { 4096 }, { 1000, 3000 } });
+
+BENCHMARK_TEMPLATE(BM_SpscThroughput, uint8_t)
+    ->ArgsProduct({ { 4096, 1 << 16 }, { 1, 64, 1024 } })
+    ->UseRealTime();
+
+BENCHMARK_TEMPLATE(BM_MpscThroughput, uint8_t)
+    ->ArgsProduct({ { 1 << 16 }, { 64 }, { 1, 2, 4 } })
+    ->UseRealTime();
+
+BENCHMARK_TEMPLATE(BM_SpscCursorTraffic, PackedSpscCursors)
+    ->ArgsProduct({ { 1024 }, { 1, 16 } })
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_SpscCursorTraffic, SpscFifoCursors)
+    ->ArgsProduct({ { 1024 }, { 1, 16 } })
+    ->UseRealTime();
+
+BENCHMARK_TEMPLATE(BM_WaitPingPong, ParkWait)
+    ->UseRealTime()
+    ->MeasureProcessCPUTime();
+BENCHMARK_TEMPLATE(BM_WaitPingPong, SpinParkWait<>)
+    ->UseRealTime()
+    ->MeasureProcessCPUTime();
+BENCHMARK_TEMPLATE(BM_WaitPingPong, BusySpinWait)
+    ->UseRealTime()
+    ->MeasureProcessCPUTime();
+BENCHMARK_TEMPLATE(BM_WaitPingPong, YieldWait)
+    ->UseRealTime()
+    ->MeasureProcessCPUTime();
+BENCHMARK_TEMPLATE(BM_WaitPingPong, SleepWait<>)
+    ->UseRealTime()
+    ->MeasureProcessCPUTime();
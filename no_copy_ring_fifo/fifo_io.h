@@ -0,0 +1,171 @@
+/*
+*   FIFO IO helpers
+*
+*   POSIX scatter/gather IO straight to and from FIFO memory.  IoVecArray exposes one or more DataBlocks as a fixed
+*   size array of struct iovec in bytes, skipping empty spans, so a wrapped block goes to the kernel as a single
+*   readv/writev/sendmsg with two entries and nothing is allocated.
+*
+*   ReadFrom and WriteTo move data between a file descriptor and a FIFO of single-byte elements with one system call.
+*   ReadFrom reserves the free space with ReserveUpTo, reads into it, and commits exactly the bytes read with
+*   CommitAndUnreserve, handing the rest back.  WriteTo peeks the readable data with PeekUpTo, writes it, and releases
+*   exactly the bytes written with ReleaseAndUnpeek, handing the rest back.  Both work with any FIFO that has those
+*   calls - NoCopyRingFifo, SpscNoCopyRingFifo (from the producer or consumer thread respectively) and
+*   SharedMemoryNoCopyRingFifo.
+*
+*   The transfer must be the only open block on its side of the FIFO, since commits and releases are in order.
+*   ReadFrom needs nothing reserved and uncommitted, and WriteTo nothing peeked and unreleased.  Otherwise they return
+*   std::errc::device_or_resource_busy without touching the FIFO or the descriptor.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <system_error>
+
+#include <sys/uio.h>
+
+#include "no_copy_ring_fifo.h"
+
+namespace FifoTemplates
+{
+    // A fixed capacity array of iovec entries built from DataBlocks.
+    template <size_t Capacity> class IoVecArray
+    {
+    public:
+        IoVecArray() = default;
+
+        template <typename T> IoVecArray(const DataBlock<T>& dataBlock)
+        {
+            Add(dataBlock);
+        }
+
+        // Append the non-empty spans of a block.  Returns false, adding nothing, if they do not all fit.
+        template <typename T> bool Add(const DataBlock<T>& dataBlock)
+        {
+            const size_t needed = ((dataBlock.spans[0].empty() ? 0 : 1) + (dataBlock.spans[1].empty() ? 0 : 1));
+            if ((_count + needed) > Capacity)
+            {
+                return false;
+            }
+
+            for (const auto& span : dataBlock.spans)
+            {
+                if (!span.empty())
+                {
+                    _ioVecs[_count].iov_base = const_cast<void*>(static_cast<const void*>(span.data()));
+                    _ioVecs[_count].iov_len = span.size_bytes();
+                    _count++;
+                }
+            }
+
+            return true;
+        }
+
+        void Clear(void) { _count = 0; }
+
+        inline const iovec* data(void) const { return _ioVecs.data(); }
+        inline int size(void) const { return static_cast<int>(_count); }
+        inline std::span<const iovec> Span(void) const { return std::span<const iovec>(_ioVecs.data(), _count); }
+
+        // Total length of the entries in bytes.
+        size_t Bytes(void) const
+        {
+            size_t bytes = 0;
+            for (size_t i = 0; i < _count; i++)
+            {
+                bytes += _ioVecs[i].iov_len;
+            }
+
+            return bytes;
+        }
+
+    private:
+        std::array<iovec, Capacity> _ioVecs{};
+        size_t _count = 0;
+    };
+
+    // Build the iovec entries for a single block.
+    template <typename T> IoVecArray<2> ToIoVec(const DataBlock<T>& dataBlock)
+    {
+        return IoVecArray<2>(dataBlock);
+    }
+
+    // Read up to maxSize bytes from a descriptor into the FIFO's free space with one readv, committing the bytes
+    // read.  Returns the number of bytes read, zero at end of file, or the error from readv.  A full FIFO returns
+    // std::errc::no_buffer_space without calling readv, so it cannot be mistaken for end of file, and outstanding
+    // reservations return std::errc::device_or_resource_busy.
+    template <typename Fifo>
+    std::expected<size_t, std::error_code> ReadFrom(Fifo& fifo, int fd, size_t maxSize = SIZE_MAX)
+    {
+        static_assert(sizeof(typename Fifo::DataBlock::element_type) == 1, "ReadFrom needs a FIFO of single-byte elements");
+
+        if (fifo.CommitableSize() != 0)
+        {
+            return std::unexpected(std::make_error_code(std::errc::device_or_resource_busy));
+        }
+
+        const auto dataBlock = fifo.ReserveUpTo(maxSize);
+        const size_t size = dataBlock.size();
+        if (size == 0)
+        {
+            return std::unexpected(std::make_error_code(std::errc::no_buffer_space));
+        }
+
+        const IoVecArray<2> ioVecs(dataBlock);
+        const ssize_t bytesRead = readv(fd, ioVecs.data(), ioVecs.size());
+
+        if (bytesRead < 0)
+        {
+            const int error = errno;
+            fifo.Unreserve(size);
+
+            return std::unexpected(std::error_code(error, std::system_category()));
+        }
+
+        fifo.CommitAndUnreserve(dataBlock, static_cast<size_t>(bytesRead));
+
+        return static_cast<size_t>(bytesRead);
+    }
+
+    // Write up to maxSize bytes of readable FIFO data to a descriptor with one writev, releasing the bytes written.
+    // Returns the number of bytes written, which is zero if the FIFO is empty, or the error from writev.  Outstanding
+    // peeks return std::errc::device_or_resource_busy.
+    template <typename Fifo>
+    std::expected<size_t, std::error_code> WriteTo(Fifo& fifo, int fd, size_t maxSize = SIZE_MAX)
+    {
+        static_assert(sizeof(typename Fifo::DataBlock::element_type) == 1, "WriteTo needs a FIFO of single-byte elements");
+
+        if (fifo.ReleasableSize() != 0)
+        {
+            return std::unexpected(std::make_error_code(std::errc::device_or_resource_busy));
+        }
+
+        const auto dataBlock = fifo.PeekUpTo(maxSize);
+        const size_t size = dataBlock.size();
+        if (size == 0)
+        {
+            return 0;
+        }
+
+        const IoVecArray<2> ioVecs(dataBlock);
+        const ssize_t bytesWritten = writev(fd, ioVecs.data(), ioVecs.size());
+
+        if (bytesWritten < 0)
+        {
+            const int error = errno;
+            fifo.Unpeek(size);
+
+            return std::unexpected(std::error_code(error, std::system_category()));
+        }
+
+        fifo.ReleaseAndUnpeek(dataBlock, static_cast<size_t>(bytesWritten));
+
+        return static_cast<size_t>(bytesWritten);
+    }
+}
@@ -0,0 +1,208 @@
+/*
+*   FIFO transactions
+*
+*   Move-only guards that tie a reserved or peeked block to a scope, so an exception between Reserve and Commit cannot
+*   leave the space reserved for good.  Each holds the block and a pointer to its FIFO, and nothing is allocated.
+*
+*   A WriteTransaction holds a reserved block.  Commit publishes all of it, or the first part of it with the rest
+*   handed back, and if the transaction is destroyed without being committed the whole block is handed back with
+*   Unreserve.  A ReadTransaction holds a peeked block and releases it when it is destroyed, unless it has already
+*   been released, or rolled back with Unpeek so the data is read again.
+*
+*   Each call acts on the transaction's own block, and the FIFO checks where that block sits.  Commits and releases
+*   are in order, so a transaction can only commit or release while its block is the oldest one open on its side of
+*   the FIFO, and can only hand space back while its block is the newest.  Otherwise Commit, Release and Rollback raise
+*   the FIFO's error policy and leave the transaction open.  A transaction destroyed while still open hands its block
+*   back without raising - if the block is not the newest it cannot be, and it stays reserved or peeked.  The guards
+*   work with NoCopyRingFifo, SpscNoCopyRingFifo (from the producer or consumer thread respectively) and
+*   SharedMemoryNoCopyRingFifo.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <utility>
+
+#include "no_copy_ring_fifo.h"
+
+namespace FifoTemplates
+{
+    template <typename Fifo> class WriteTransaction
+    {
+    public:
+        using DataBlock = typename Fifo::DataBlock;
+
+        WriteTransaction(void) = default;
+
+        // Take ownership of a block reserved from the FIFO, for example by ReserveUpTo or ReserveContiguous.
+        WriteTransaction(Fifo& fifo, const DataBlock& dataBlock) : _fifo(&fifo), _dataBlock(dataBlock) {}
+
+        WriteTransaction(WriteTransaction&& other) noexcept :
+            _fifo(std::exchange(other._fifo, nullptr)),
+            _dataBlock(other._dataBlock)
+        {
+        }
+
+        WriteTransaction& operator=(WriteTransaction&& other) noexcept
+        {
+            if (this != &other)
+            {
+                Abandon();
+                _fifo = std::exchange(other._fifo, nullptr);
+                _dataBlock = other._dataBlock;
+            }
+
+            return *this;
+        }
+
+        WriteTransaction(const WriteTransaction&) = delete;
+        WriteTransaction& operator=(const WriteTransaction&) = delete;
+
+        ~WriteTransaction()
+        {
+            Abandon();
+        }
+
+        // Commit the whole block.
+        void Commit(void)
+        {
+            Commit(_dataBlock.size());
+        }
+
+        // Commit the first size elements of the block and hand back the rest.
+        // The FIFO's error policy is raised if the block is not the oldest open reservation, or if size is less than
+        // the block size and the block is not the newest.
+        void Commit(size_t size)
+        {
+            if (_fifo != nullptr)
+            {
+                _fifo->CommitAndUnreserve(_dataBlock, size);
+                _fifo = nullptr;
+            }
+        }
+
+        // Hand back the whole block without committing any of it.
+        // The FIFO's error policy is raised if the block is not the newest open reservation.
+        void Rollback(void)
+        {
+            Commit(0);
+        }
+
+        // The transaction is open until it is committed or rolled back.
+        inline bool IsOpen(void) const { return (_fifo != nullptr); }
+        inline const DataBlock& Block(void) const { return _dataBlock; }
+
+    private:
+        // Roll back without raising, for the destructor.
+        void Abandon(void) noexcept
+        {
+            if (_fifo != nullptr)
+            {
+                (void)_fifo->TryCommitAndUnreserve(_dataBlock, 0);
+                _fifo = nullptr;
+            }
+        }
+
+        Fifo* _fifo = nullptr;
+        DataBlock _dataBlock;
+    };
+
+    template <typename Fifo> class ReadTransaction
+    {
+    public:
+        using DataBlock = typename Fifo::DataBlock;
+
+        ReadTransaction(void) = default;
+
+        // Take ownership of a block peeked from the FIFO, for example by PeekUpTo.
+        ReadTransaction(Fifo& fifo, const DataBlock& dataBlock) : _fifo(&fifo), _dataBlock(dataBlock) {}
+
+        ReadTransaction(ReadTransaction&& other) noexcept :
+            _fifo(std::exchange(other._fifo, nullptr)),
+            _dataBlock(other._dataBlock)
+        {
+        }
+
+        ReadTransaction& operator=(ReadTransaction&& other) noexcept
+        {
+            if (this != &other)
+            {
+                Finish();
+                _fifo = std::exchange(other._fifo, nullptr);
+                _dataBlock = other._dataBlock;
+            }
+
+            return *this;
+        }
+
+        ReadTransaction(const ReadTransaction&) = delete;
+        ReadTransaction& operator=(const ReadTransaction&) = delete;
+
+        ~ReadTransaction()
+        {
+            Finish();
+        }
+
+        // Release the whole block.
+        void Release(void)
+        {
+            Release(_dataBlock.size());
+        }
+
+        // Release the first size elements of the block and hand back the rest, so it is read again.
+        // The FIFO's error policy is raised if the block is not the oldest open peek, or if size is less than the
+        // block size and the block is not the newest.
+        void Release(size_t size)
+        {
+            if (_fifo != nullptr)
+            {
+                _fifo->ReleaseAndUnpeek(_dataBlock, size);
+                _fifo = nullptr;
+            }
+        }
+
+        // Hand back the whole block without releasing any of it, so it is read again.
+        // The FIFO's error policy is raised if the block is not the newest open peek.
+        void Rollback(void)
+        {
+            Release(0);
+        }
+
+        // The transaction is open until it is released or rolled back.
+        inline bool IsOpen(void) const { return (_fifo != nullptr); }
+        inline const DataBlock& Block(void) const { return _dataBlock; }
+
+    private:
+        // Release the whole block without raising, for the destructor.  A block that cannot be released yet is handed
+        // back instead, so it is read again.
+        void Finish(void) noexcept
+        {
+            if (_fifo != nullptr)
+            {
+                if (!_fifo->TryReleaseAndUnpeek(_dataBlock, _dataBlock.size()))
+                {
+                    (void)_fifo->TryReleaseAndUnpeek(_dataBlock, 0);
+                }
+
+                _fifo = nullptr;
+            }
+        }
+
+        Fifo* _fifo = nullptr;
+        DataBlock _dataBlock;
+    };
+
+    // Reserve a block in a write transaction.
+    // The FIFO's error policy is raised if there is insufficient reservable space.
+    template <typename Fifo> [[nodiscard]] WriteTransaction<Fifo> ReserveTransaction(Fifo& fifo, size_t size)
+    {
+        return WriteTransaction<Fifo>(fifo, fifo.Reserve(size));
+    }
+
+    // Peek a block in a read transaction.
+    // The FIFO's error policy is raised if there is insufficient committed data.
+    template <typename Fifo> [[nodiscard]] ReadTransaction<Fifo> PeekTransaction(Fifo& fifo, size_t size)
+    {
+        return ReadTransaction<Fifo>(fifo, fifo.PeekBlock(size));
+    }
+}
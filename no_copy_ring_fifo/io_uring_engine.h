@@ -0,0 +1,409 @@
+/*
+*   IoUringEngine class
+*
+*   Linux io_uring backend for a NoCopyRingFifo of single-byte elements, using the raw system calls so there is no
+*   dependency on liburing.  The FIFO buffer is registered with the kernel once as a fixed buffer, so reads and writes
+*   go straight between a descriptor and FIFO memory as IORING_OP_READ_FIXED and IORING_OP_WRITE_FIXED without the
+*   kernel mapping the pages for every request.
+*
+*   StartRead reserves free space and queues a read into it, and StartWrite peeks readable data and queues a write
+*   from it.  Complete submits the queued requests, optionally waits, and handles the completions - a read commits the
+*   bytes read and a write releases the bytes written, handing the rest back with CommitAndUnreserve or
+*   ReleaseAndUnpeek as ReadFrom and WriteTo do (see fifo_io.h).
+*
+*   At most one read and one write are in flight at a time.  That keeps every short transfer at the end of the
+*   reserved or peeked space, where it can be handed back, and keeps stream descriptors like pipes in order.  A
+*   request covers one contiguous span, so with non-mirrored storage a block that wraps is transferred in two
+*   requests.  While a read is in flight the engine owns the producer side of the FIFO, and while a write is in
+*   flight it owns the consumer side.  StartRead refuses while the caller has a block reserved and StartWrite while
+*   it has one peeked, and the caller must not reserve or peek on those sides until the request completes.
+*
+*   Registering the buffer pins its pages, which counts against RLIMIT_MEMLOCK.  The FIFO must outlive the engine.
+*   Destroying the engine cancels the requests still in flight and waits for them to finish, handling whatever they
+*   transferred before the cancellation took effect and handing the rest of their blocks back.  If the ring cannot be
+*   entered to wait, the blocks of the requests it could not wait for are left reserved or peeked, since the kernel
+*   may still be transferring into or out of them.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <system_error>
+#include <utility>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "no_copy_ring_fifo.h"
+
+namespace FifoTemplates
+{
+    template <typename Fifo> class IoUringEngine
+    {
+        static_assert(sizeof(typename Fifo::DataBlock::element_type) == 1, "IoUringEngine needs a FIFO of single-byte elements");
+
+    public:
+        using DataBlock = typename Fifo::DataBlock;
+
+        // Results of the requests handled by one Complete call.
+        struct Completions
+        {
+            std::optional<int> read;    // Bytes read, zero at end of file, or a negative errno.
+            std::optional<int> write;   // Bytes written, or a negative errno.
+        };
+
+        // Offset for requests on stream descriptors, or to use and advance the file position.
+        static constexpr int64_t currentPosition = -1;
+
+        // Set up the ring and register the FIFO buffer.  Throws std::system_error if the kernel refuses either.
+        IoUringEngine(Fifo& fifo) : _fifo(fifo)
+        {
+            io_uring_params params{};
+            _ringFd = static_cast<int>(syscall(SYS_io_uring_setup, ringEntries, &params));
+            if (_ringFd < 0)
+            {
+                throw std::system_error(errno, std::system_category(), "io_uring_setup failed");
+            }
+
+            try
+            {
+                MapRings(params);
+                RegisterBuffer();
+            }
+            catch (...)
+            {
+                Unmap();
+                close(_ringFd);
+                throw;
+            }
+        }
+
+        IoUringEngine(const IoUringEngine&) = delete;
+        IoUringEngine& operator=(const IoUringEngine&) = delete;
+
+        ~IoUringEngine()
+        {
+            // A block still in flight after cancelling is left reserved or peeked rather than handed back, since
+            // the ring is torn down asynchronously and the kernel may go on using it.
+            Cancel();
+            Unmap();
+            close(_ringFd);
+        }
+
+        // Queue a read of up to maxSize bytes from a descriptor into the FIFO's free space.  Returns false, queueing
+        // nothing, if a read is already in flight, the caller has a block reserved or the FIFO is full.
+        bool StartRead(int fd, size_t maxSize = SIZE_MAX, int64_t offset = currentPosition)
+        {
+            if (ReadInFlight() || (_fifo.CommitableSize() != 0))
+            {
+                return false;
+            }
+
+            _readBlock = _fifo.ReserveUpTo(std::min(maxSize, maxRequestSize), 0, UpTo::Contiguous);
+            if (!_readBlock.isValid())
+            {
+                return false;
+            }
+
+            Queue(IORING_OP_READ_FIXED, readTag, fd, _readBlock.spans[0].data(), _readBlock.size(), offset);
+
+            return true;
+        }
+
+        // Queue a write of up to maxSize bytes of readable FIFO data to a descriptor.  Returns false, queueing
+        // nothing, if a write is already in flight, the caller has a block peeked or the FIFO is empty.
+        bool StartWrite(int fd, size_t maxSize = SIZE_MAX, int64_t offset = currentPosition)
+        {
+            if (WriteInFlight() || (_fifo.ReleasableSize() != 0))
+            {
+                return false;
+            }
+
+            _writeBlock = _fifo.PeekUpTo(std::min(maxSize, maxRequestSize), 0, UpTo::Contiguous);
+            if (!_writeBlock.isValid())
+            {
+                return false;
+            }
+
+            Queue(IORING_OP_WRITE_FIXED, writeTag, fd, _writeBlock.spans[0].data(), _writeBlock.size(), offset);
+
+            return true;
+        }
+
+        inline bool ReadInFlight(void) const { return _readBlock.isValid(); }
+        inline bool WriteInFlight(void) const { return _writeBlock.isValid(); }
+
+        // Submit the queued requests, wait until at least waitFor requests have completed (capped at the number in
+        // flight), and handle every completion available.  Returns the results, or the error from io_uring_enter.
+        std::expected<Completions, std::error_code> Complete(unsigned waitFor = 0)
+        {
+            const std::error_code error = Enter(waitFor);
+            if (error)
+            {
+                return std::unexpected(error);
+            }
+
+            return Reap(true);
+        }
+
+    private:
+        static constexpr unsigned ringEntries = 4;
+        static constexpr uint64_t readTag = 1;
+        static constexpr uint64_t writeTag = 2;
+        static constexpr uint64_t cancelTag = 3;
+        static constexpr size_t maxRequestSize = UINT32_MAX;
+
+        void MapRings(const io_uring_params& params)
+        {
+            _sqRingSize = (params.sq_off.array + (params.sq_entries * sizeof(uint32_t)));
+            _cqRingSize = (params.cq_off.cqes + (params.cq_entries * sizeof(io_uring_cqe)));
+
+            // Newer kernels map both rings in one region.
+            const bool singleMap = ((params.features & IORING_FEAT_SINGLE_MMAP) != 0);
+            if (singleMap)
+            {
+                _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+            }
+
+            _sqRing = Map(_sqRingSize, IORING_OFF_SQ_RING);
+            _cqRing = (singleMap ? _sqRing : Map(_cqRingSize, IORING_OFF_CQ_RING));
+
+            _sqesSize = (params.sq_entries * sizeof(io_uring_sqe));
+            _sqes = static_cast<io_uring_sqe*>(Map(_sqesSize, IORING_OFF_SQES));
+
+            auto* sq = static_cast<uint8_t*>(_sqRing);
+            _sqTail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+            _sqMask = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+            _sqArray = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+
+            auto* cq = static_cast<uint8_t*>(_cqRing);
+            _cqHead = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+            _cqTail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+            _cqMask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+            _cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        }
+
+        void* Map(size_t size, off_t offset)
+        {
+            void* mapping = mmap(nullptr, size, (PROT_READ | PROT_WRITE), (MAP_SHARED | MAP_POPULATE), _ringFd, offset);
+            if (mapping == MAP_FAILED)
+            {
+                throw std::system_error(errno, std::system_category(), "io_uring mmap failed");
+            }
+
+            return mapping;
+        }
+
+        void Unmap(void)
+        {
+            if (_sqes != nullptr)
+            {
+                munmap(_sqes, _sqesSize);
+            }
+
+            if ((_cqRing != nullptr) && (_cqRing != _sqRing))
+            {
+                munmap(_cqRing, _cqRingSize);
+            }
+
+            if (_sqRing != nullptr)
+            {
+                munmap(_sqRing, _sqRingSize);
+            }
+        }
+
+        // Register the buffer as fixed buffer 0.
+        void RegisterBuffer(void)
+        {
+            const auto buffer = std::as_writable_bytes(_fifo.Buffer());
+            const iovec ioVec = { buffer.data(), buffer.size() };
+
+            if (syscall(SYS_io_uring_register, _ringFd, IORING_REGISTER_BUFFERS, &ioVec, 1) < 0)
+            {
+                throw std::system_error(errno, std::system_category(), "io_uring buffer registration failed");
+            }
+        }
+
+        // Fill in the next submission queue entry for a transfer and publish it to the kernel.
+        void Queue(uint8_t opcode, uint64_t tag, int fd, void* data, size_t size, int64_t offset)
+        {
+            io_uring_sqe sqe{};
+            sqe.opcode = opcode;
+            sqe.fd = fd;
+            sqe.off = static_cast<uint64_t>(offset);
+            sqe.addr = reinterpret_cast<uint64_t>(data);
+            sqe.len = static_cast<uint32_t>(size);
+            sqe.buf_index = 0;
+            sqe.user_data = tag;
+
+            Push(sqe);
+        }
+
+        // Queue a cancellation of the request with the tag.  Its own completion is ignored by Reap.
+        void QueueCancel(uint64_t tag)
+        {
+            io_uring_sqe sqe{};
+            sqe.opcode = IORING_OP_ASYNC_CANCEL;
+            sqe.fd = -1;
+            sqe.addr = tag;
+            sqe.user_data = cancelTag;
+
+            Push(sqe);
+        }
+
+        // There are never more than two requests in flight and a cancellation for each, so the queue cannot be full.
+        void Push(const io_uring_sqe& sqe)
+        {
+            const uint32_t tail = *_sqTail;
+            const uint32_t index = (tail & _sqMask);
+
+            _sqes[index] = sqe;
+            _sqArray[index] = index;
+            std::atomic_ref<uint32_t>(*_sqTail).store((tail + 1), std::memory_order_release);
+            _toSubmit++;
+        }
+
+        // Submit the queued requests and wait until at least waitFor requests have completed, capped at the number in
+        // flight.  Returns the error from io_uring_enter, retrying it while it is interrupted.
+        std::error_code Enter(unsigned waitFor)
+        {
+            waitFor = std::min(waitFor, static_cast<unsigned>(ReadInFlight() + WriteInFlight()));
+
+            if ((_toSubmit != 0) || (waitFor > Ready()))
+            {
+                const unsigned flags = ((waitFor != 0) ? IORING_ENTER_GETEVENTS : 0);
+
+                for (;;)
+                {
+                    const long submitted = syscall(SYS_io_uring_enter, _ringFd, _toSubmit, waitFor, flags, nullptr, 0);
+                    if (submitted >= 0)
+                    {
+                        _toSubmit -= static_cast<unsigned>(submitted);
+                        break;
+                    }
+
+                    if (errno != EINTR)
+                    {
+                        return std::error_code(errno, std::system_category());
+                    }
+                }
+            }
+
+            return std::error_code();
+        }
+
+        // Cancel the requests in flight and wait until the kernel has finished with them, handling their completions
+        // without raising.  Gives up if the ring cannot be entered, leaving the requests it could not wait for in
+        // flight.
+        void Cancel(void) noexcept
+        {
+            if (ReadInFlight())
+            {
+                QueueCancel(readTag);
+            }
+
+            if (WriteInFlight())
+            {
+                QueueCancel(writeTag);
+            }
+
+            while (ReadInFlight() || WriteInFlight())
+            {
+                if (Enter(2))
+                {
+                    break;
+                }
+
+                (void)Reap(false);
+            }
+        }
+
+        // Number of completions waiting in the completion queue.
+        inline unsigned Ready(void) const
+        {
+            return (std::atomic_ref<uint32_t>(*_cqTail).load(std::memory_order_acquire) - *_cqHead);
+        }
+
+        // Commit or release the transferred bytes of every completed request.  StartRead and StartWrite make sure the
+        // engine's block is the only one open on its side, so these only fail if the caller broke that while the
+        // request was in flight, which raises unless raise is false.
+        Completions Reap(bool raise)
+        {
+            Completions completions;
+
+            uint32_t head = *_cqHead;
+            const uint32_t tail = std::atomic_ref<uint32_t>(*_cqTail).load(std::memory_order_acquire);
+
+            for (; head != tail; head++)
+            {
+                // Consume the entry first, so a hand-back that raises does not leave it to be handled again.
+                const io_uring_cqe cqe = _cqes[head & _cqMask];
+                std::atomic_ref<uint32_t>(*_cqHead).store((head + 1), std::memory_order_release);
+
+                const size_t transferred = ((cqe.res > 0) ? static_cast<size_t>(cqe.res) : 0);
+
+                if (cqe.user_data == readTag)
+                {
+                    const DataBlock readBlock = std::exchange(_readBlock, DataBlock());
+                    if (raise)
+                    {
+                        _fifo.CommitAndUnreserve(readBlock, transferred);
+                    }
+                    else
+                    {
+                        (void)_fifo.TryCommitAndUnreserve(readBlock, transferred);
+                    }
+
+                    completions.read = cqe.res;
+                }
+                else if (cqe.user_data == writeTag)
+                {
+                    const DataBlock writeBlock = std::exchange(_writeBlock, DataBlock());
+                    if (raise)
+                    {
+                        _fifo.ReleaseAndUnpeek(writeBlock, transferred);
+                    }
+                    else
+                    {
+                        (void)_fifo.TryReleaseAndUnpeek(writeBlock, transferred);
+                    }
+
+                    completions.write = cqe.res;
+                }
+            }
+
+            return completions;
+        }
+
+        Fifo& _fifo;
+        int _ringFd = -1;
+
+        void* _sqRing = nullptr;
+        void* _cqRing = nullptr;
+        io_uring_sqe* _sqes = nullptr;
+        size_t _sqRingSize = 0;
+        size_t _cqRingSize = 0;
+        size_t _sqesSize = 0;
+
+        uint32_t* _sqTail = nullptr;
+        uint32_t* _sqArray = nullptr;
+        uint32_t _sqMask = 0;
+        uint32_t* _cqHead = nullptr;
+        uint32_t* _cqTail = nullptr;
+        uint32_t _cqMask = 0;
+        io_uring_cqe* _cqes = nullptr;
+
+        unsigned _toSubmit = 0;
+        DataBlock _readBlock;
+        DataBlock _writeBlock;
+    };
+}
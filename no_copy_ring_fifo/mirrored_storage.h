@@ -0,0 +1,121 @@
+/*
+*   MirroredStorage class
+*
+*   Linux storage for NoCopyRingFifo that maps the same memfd pages twice, back to back, in one reserved range of
+*   virtual memory.  An access that runs off the end of the first mapping lands at the start of the buffer through the
+*   second mapping, so every reserved or read block is a single contiguous span and DataBlock::isSplit() is always
+*   false.
+*
+*   The mapping works on whole pages, so the buffer size in bytes must be a multiple of the page size.  RoundUpSize
+*   gives the smallest valid FIFO size for a requested number of elements.
+*/
+
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <format>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace FifoTemplates
+{
+    template <typename T> class MirroredStorage
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "MirroredStorage elements must be trivially copyable");
+
+    public:
+        static constexpr bool isMirrored = true;
+
+        MirroredStorage(size_t size) : _size(size)
+        {
+            if ((size == 0) || (size != RoundUpSize(size)))
+            {
+                throw std::invalid_argument(
+                    std::format("Mirrored FIFO size must fill whole pages - requested {}, nearest {}",
+                    size,
+                    RoundUpSize(size))
+                    );
+            }
+
+            const size_t byteSize = (size * sizeof(T));
+
+            const int fd = memfd_create("NoCopyRingFifo", MFD_CLOEXEC);
+            if (fd < 0)
+            {
+                throw std::system_error(errno, std::system_category(), "memfd_create failed");
+            }
+
+            if (ftruncate(fd, static_cast<off_t>(byteSize)) != 0)
+            {
+                const int error = errno;
+                close(fd);
+                throw std::system_error(error, std::system_category(), "ftruncate failed");
+            }
+
+            // Reserve address space for both copies, then map the file over each half.
+            void* base = mmap(nullptr, (2 * byteSize), PROT_NONE, (MAP_PRIVATE | MAP_ANONYMOUS), -1, 0);
+            if (base == MAP_FAILED)
+            {
+                const int error = errno;
+                close(fd);
+                throw std::system_error(error, std::system_category(), "mmap reserve failed");
+            }
+
+            for (size_t half = 0; half < 2; half++)
+            {
+                void* target = (static_cast<uint8_t*>(base) + (half * byteSize));
+                void* mapped = mmap(target, byteSize, (PROT_READ | PROT_WRITE), (MAP_SHARED | MAP_FIXED), fd, 0);
+                if (mapped == MAP_FAILED)
+                {
+                    const int error = errno;
+                    munmap(base, (2 * byteSize));
+                    close(fd);
+                    throw std::system_error(error, std::system_category(), "mmap mirror failed");
+                }
+            }
+
+            // The mappings keep the memory alive, the descriptor is no longer needed.
+            close(fd);
+
+            _buffer = static_cast<T*>(base);
+        }
+
+        MirroredStorage(MirroredStorage&& other) noexcept : _buffer(std::exchange(other._buffer, nullptr)), _size(other._size) {}
+
+        MirroredStorage(const MirroredStorage&) = delete;
+        MirroredStorage& operator=(const MirroredStorage&) = delete;
+
+        ~MirroredStorage()
+        {
+            if (_buffer != nullptr)
+            {
+                munmap(_buffer, (2 * _size * sizeof(T)));
+            }
+        }
+
+        // Return the smallest FIFO size of at least the requested number of elements that fills whole pages.
+        static size_t RoundUpSize(size_t size)
+        {
+            const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            const size_t granularity = (pageSize / std::gcd(pageSize, sizeof(T)));
+
+            return (((size + granularity - 1) / granularity) * granularity);
+        }
+
+        inline size_t Size(void) const { return _size; }
+        inline std::span<T> Span(void) { return std::span<T>(_buffer, (2 * _size)); }
+
+    private:
+        T* _buffer = nullptr;
+        size_t _size;
+    };
+}
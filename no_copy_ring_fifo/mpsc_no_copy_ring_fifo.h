@@ -0,0 +1,888 @@
+/*
+*   MpscNoCopyRingFifo class
+*
+*   Multi-producer/single-consumer version of NoCopyRingFifo.  Any number of threads may reserve and commit, and a
+*   single consumer thread reads.  Reserve claims space with a compare-and-swap on a shared reserve cursor, so no lock
+*   is taken on either side.
+*
+*   Commits do not have to happen in reserve order.  Commit takes the DataBlock returned by Reserve, and the commit
+*   cursor only moves past a block once every block before it has committed, so the consumer always sees a contiguous
+*   run of completed data.
+*
+*   Reads can complete out of order in the same way.  The consumer peeks consecutive blocks, and each can be handed
+*   back with Release(dataBlock) from any thread once its asynchronous write completes.  The space is reclaimed past
+*   a contiguous run of released blocks.
+*
+*   Both kinds of completion are tracked with a CompletionCursor, which parks each block completed ahead of an older
+*   one in a slot until the older one completes.  The number of slots is a constructor argument, capped at the FIFO
+*   size, so the bookkeeping does not grow with the FIFO.  Completing a block ahead of the others while every slot is
+*   in use raises FifoError::TooManyOutOfOrder, and the block stays outstanding so the call can be retried once older
+*   blocks have completed.
+*
+*   Reserve, ReadBlock and PeekBlock have blocking overloads with a timeout and a wait strategy, as for
+*   SpscNoCopyRingFifo.  Every blocked producer is woken when space is released, and those that lose the race for it
+*   go back to waiting.
+*
+*   All cursors are free-running 64-bit element counts, and a cursor's buffer position is the cursor modulo the FIFO
+*   size.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <expected>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "no_copy_ring_fifo.h"
+
+namespace FifoTemplates
+{
+    // A free-running cursor that advances past blocks completed in any order.
+    //
+    // A block that completes at the cursor moves the cursor straight past it.  A block that completes ahead of the
+    // cursor is parked in one of a fixed number of slots, which holds its start and end, and the cursor only moves past
+    // it once every block before it has completed.  Whichever thread finds the block at the cursor parked moves the
+    // cursor, so Complete may be called from any number of threads.  The slots are scanned to find the block at the
+    // cursor, so there should be few of them, and a block cannot complete ahead of the cursor while all are in use.
+    class CompletionCursor
+    {
+    public:
+        static constexpr size_t noSlot = SIZE_MAX;
+
+        CompletionCursor(size_t slots) :
+            _slotCount(slots),
+            _starts(new std::atomic<uint64_t>[slots]),
+            _ends(new std::atomic<uint64_t>[slots])
+        {
+            Reset();
+        }
+
+        inline uint64_t Load(std::memory_order order) const { return _cursor.load(order); }
+        inline size_t Slots(void) const { return _slotCount; }
+
+        // Whether the block starting at start has completed and is parked ahead of the cursor.
+        bool Parked(uint64_t start) const
+        {
+            for (size_t slot = 0; slot < _slotCount; slot++)
+            {
+                if (_starts[slot].load(std::memory_order_acquire) == start)
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        // Claim a slot for a block that may complete ahead of the cursor, so that completing it cannot fail.  Returns
+        // noSlot if every slot is in use.
+        size_t Claim(void)
+        {
+            for (size_t slot = 0; slot < _slotCount; slot++)
+            {
+                uint64_t start = emptySlot;
+                if ((_starts[slot].load(std::memory_order_relaxed) == emptySlot) &&
+                    _starts[slot].compare_exchange_strong(start, claimedSlot, std::memory_order_acquire))
+                {
+                    return slot;
+                }
+            }
+
+            return noSlot;
+        }
+
+        // Hand back a claimed slot that was not used.  Does nothing for noSlot.
+        inline void Unclaim(size_t slot)
+        {
+            if (slot != noSlot)
+            {
+                _starts[slot].store(emptySlot, std::memory_order_release);
+            }
+        }
+
+        // Mark the block [start, end) as completed and move the cursor past any run of completed blocks it joins.
+        // Returns false, changing nothing, if the block is ahead of the cursor and every slot is in use.
+        bool Complete(uint64_t start, uint64_t end)
+        {
+            if ((end == start) || CompleteAtCursor(start, end))
+            {
+                return true;
+            }
+
+            const size_t slot = Claim();
+            if (slot == noSlot)
+            {
+                return false;
+            }
+
+            Park(slot, start, end);
+
+            return true;
+        }
+
+        // Complete a block with a slot from Claim, which is parked in if the block is ahead of the cursor and handed
+        // back otherwise.  A block known to be at the cursor, so that no other block can move the cursor past it, can
+        // pass noSlot.
+        void Complete(uint64_t start, uint64_t end, size_t slot)
+        {
+            if ((end == start) || CompleteAtCursor(start, end))
+            {
+                Unclaim(slot);
+                return;
+            }
+
+            assert(slot != noSlot);
+            Park(slot, start, end);
+        }
+
+        // Reset the cursor to zero and empty the slots.  Not thread safe.
+        void Reset(void)
+        {
+            _cursor.store(0, std::memory_order_relaxed);
+            _parked.store(0, std::memory_order_relaxed);
+
+            for (size_t slot = 0; slot < _slotCount; slot++)
+            {
+                _starts[slot].store(emptySlot, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        // Slot starts that mark a free slot and one claimed but not yet holding a block.  Cursors never get that far.
+        static constexpr uint64_t emptySlot = UINT64_MAX;
+        static constexpr uint64_t claimedSlot = (UINT64_MAX - 1);
+
+        // Move the cursor past a block that starts at it, then past any parked blocks that follow.  Returns false if
+        // the cursor has not reached the block yet.
+        bool CompleteAtCursor(uint64_t start, uint64_t end)
+        {
+            uint64_t cursor = start;
+            if (!_cursor.compare_exchange_strong(cursor, end, std::memory_order_seq_cst))
+            {
+                return false;
+            }
+
+            Advance();
+
+            return true;
+        }
+
+        // Park a block in a claimed slot, then try to move the cursor in case it has reached the block since.  The
+        // start store and the cursor load must be sequentially consistent with the cursor update and slot loads in
+        // Advance, so that either this thread sees the cursor reach the block or the thread moving the cursor sees the
+        // block.
+        void Park(size_t slot, uint64_t start, uint64_t end)
+        {
+            _parked.fetch_add(1, std::memory_order_seq_cst);
+            _ends[slot].store(end, std::memory_order_relaxed);
+            _starts[slot].store(start, std::memory_order_seq_cst);
+            Advance();
+        }
+
+        // Move the cursor past every consecutive parked block.  A parked block is taken out of its slot before the
+        // cursor moves past it, so only the thread that took the block at the cursor can move the cursor on.
+        void Advance(void)
+        {
+            while (_parked.load(std::memory_order_seq_cst) != 0)
+            {
+                const uint64_t cursor = _cursor.load(std::memory_order_seq_cst);
+
+                size_t slot = 0;
+                while ((slot < _slotCount) && (_starts[slot].load(std::memory_order_seq_cst) != cursor))
+                {
+                    slot++;
+                }
+
+                if (slot == _slotCount)
+                {
+                    return;
+                }
+
+                // On failure another thread has taken the block.
+                uint64_t start = cursor;
+                if (_starts[slot].compare_exchange_strong(start, claimedSlot, std::memory_order_seq_cst))
+                {
+                    _cursor.store(_ends[slot].load(std::memory_order_relaxed), std::memory_order_seq_cst);
+                    _starts[slot].store(emptySlot, std::memory_order_release);
+                    _parked.fetch_sub(1, std::memory_order_seq_cst);
+                }
+            }
+        }
+
+        size_t _slotCount;
+        std::unique_ptr<std::atomic<uint64_t>[]> _starts;
+        std::unique_ptr<std::atomic<uint64_t>[]> _ends;
+        std::atomic<size_t> _parked = 0;
+
+        alignas(cacheLineSize) std::atomic<uint64_t> _cursor = 0;
+    };
+
+    template <typename T, typename ErrorPolicy = DefaultErrorPolicy, typename WaitStrategy = YieldWait>
+    class MpscNoCopyRingFifo
+    {
+    public:
+        using DataBlock = FifoTemplates::DataBlock<T>;
+
+        // Number of blocks on each side that can complete ahead of an older block by default.
+        static constexpr size_t defaultOutOfOrderBlocks = 64;
+
+        MpscNoCopyRingFifo(size_t size, size_t outOfOrderBlocks = defaultOutOfOrderBlocks) :
+            maxSize(size),
+            _commitCursor(std::min(size, outOfOrderBlocks)),
+            _readCursor(std::min(size, outOfOrderBlocks))
+        {
+            _ringBuffer.resize(size);
+            _ringBufferSpan = std::span<T>(_ringBuffer);
+        }
+
+        // Reserve a block of FIFO memory, returning a FifoBlock object.  May be called from any producer thread.
+        // The error policy is raised if there is insufficient reservable space.
+        DataBlock Reserve(size_t size)
+        {
+            DataBlock dataBlock;
+            if (!AdvanceReserve(size, dataBlock))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientSpace, size, ReservableSize());
+            }
+
+            return dataBlock;
+        }
+
+        // Commit a reserved block, in any order.  The block becomes readable once every block reserved before it has
+        // also been committed.  May be called from any thread.
+        // The error policy is raised if the block is not an outstanding reservation, or if it would complete ahead of
+        // an older block while every slot is in use.
+        void Commit(const DataBlock& dataBlock)
+        {
+            const auto result = AdvanceCommit(dataBlock);
+            if (!result.has_value())
+            {
+                ErrorPolicy::Raise(result.error(), dataBlock.size(), CommitableSize());
+            }
+        }
+
+        // Commit the first size elements of a reserved block and hand back the rest, for example after a read that
+        // returned less than was reserved for it.  The rest can only be handed back while the block is still the most
+        // recent reservation, as the space after it may already belong to another producer.  May be called from any
+        // thread.
+        // The error policy is raised if the block is not an outstanding reservation, or if it is not the most recent
+        // reservation and size is less than the block size.
+        void CommitAndUnreserve(const DataBlock& dataBlock, size_t size)
+        {
+            const auto result = AdvanceCommitAndUnreserve(dataBlock, size);
+            if (!result.has_value())
+            {
+                ErrorPolicy::Raise(result.error(), dataBlock.size(), CommitableSize());
+            }
+        }
+
+        // Hand back a whole reserved block without committing any of it, for example when filling it failed.  As with
+        // CommitAndUnreserve, only the most recent reservation can be handed back.
+        // The error policy is raised if the block is not the most recent outstanding reservation.
+        void Unreserve(const DataBlock& dataBlock)
+        {
+            CommitAndUnreserve(dataBlock, 0);
+        }
+
+        // Blocking versions of Reserve, ReadBlock and PeekBlock, which wait up to the timeout for space or data
+        // instead of failing straight away.  Pass waitForever to wait with no timeout.
+        // The error policy is raised if the call times out, or straight away if the size can never fit in the FIFO.
+        DataBlock Reserve(size_t size, std::chrono::nanoseconds timeout)
+        {
+            DataBlock dataBlock;
+            if (!WaitReserve(size, timeout, dataBlock))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientSpace, size, ReservableSize());
+            }
+
+            return dataBlock;
+        }
+
+        DataBlock ReadBlock(size_t size, std::chrono::nanoseconds timeout)
+        {
+            if (!WaitForData(size, timeout))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientData, size, ReadableSize());
+            }
+
+            return RaiseOnError(AdvanceRead(size), size);
+        }
+
+        DataBlock PeekBlock(size_t size, std::chrono::nanoseconds timeout)
+        {
+            if (!WaitForData(size, timeout))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientData, size, ReadableSize());
+            }
+
+            return AdvancePeek(size);
+        }
+
+        // Reserve as much space as is available, up to size elements, see NoCopyRingFifo.  The size is claimed in
+        // the same compare-and-swap as the space, so it cannot be taken by another producer in between.  May be
+        // called from any producer thread.
+        // The error policy is raised if less than minSize elements are available.
+        DataBlock ReserveUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            DataBlock dataBlock;
+            if (!AdvanceReserveUpTo(size, minSize, upTo, dataBlock))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientSpace, minSize, ReservableSize());
+            }
+
+            return dataBlock;
+        }
+
+        // Read or peek as much committed data as is available, up to size elements.  Consumer thread only.
+        // The error policy is raised if less than minSize elements are available.
+        DataBlock ReadUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            const size_t blockSize = ReadUpToSize(size, upTo);
+            if (blockSize < minSize)
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientData, minSize, blockSize);
+            }
+
+            return RaiseOnError(AdvanceRead(blockSize), blockSize);
+        }
+
+        DataBlock PeekUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            const size_t blockSize = ReadUpToSize(size, upTo);
+            if (blockSize < minSize)
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientData, minSize, blockSize);
+            }
+
+            return AdvancePeek(blockSize);
+        }
+
+        inline size_t ReservableSize(void) const
+        {
+            return (maxSize - (_reserveCursor.load(std::memory_order_relaxed) - _readCursor.Load(std::memory_order_acquire)));
+        }
+        inline size_t CommitableSize(void) const
+        {
+            return (_reserveCursor.load(std::memory_order_relaxed) - _commitCursor.Load(std::memory_order_relaxed));
+        }
+        inline size_t ReadableSize(void) const
+        {
+            _cachedCommitCursor = _commitCursor.Load(std::memory_order_acquire);
+
+            return (_cachedCommitCursor - _peekCursor.load(std::memory_order_relaxed));
+        }
+        inline size_t ReleasableSize(void) const
+        {
+            return (_peekCursor.load(std::memory_order_relaxed) - _readCursor.Load(std::memory_order_relaxed));
+        }
+
+        // Get a block of comitted data to read.  The block is freed immediately, so the data must be consumed before
+        // a producer can reserve it again.  Consumer thread only.
+        // The error policy is raised if there is insufficient committed data for the read, or if peeked blocks are
+        // outstanding and every slot is in use.
+        DataBlock ReadBlock(size_t size)
+        {
+            if (!HasReadableData(size))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientData, size, ReadableSize());
+            }
+
+            return RaiseOnError(AdvanceRead(size), size);
+        }
+
+        // Get a block of committed data to read without freeing it.  Consumer thread only.
+        // The error policy is raised if there is insufficient committed data for the peek.
+        DataBlock PeekBlock(size_t size)
+        {
+            if (!HasReadableData(size))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientData, size, ReadableSize());
+            }
+
+            return AdvancePeek(size);
+        }
+
+        // Release a block of peeked data, returning it to the producers.  Blocks are released in the order they were
+        // peeked.  Consumer thread only, and not to be mixed with releasing individual blocks.
+        // The error policy is raised if there is insufficient peeked data for the release.
+        void Release(size_t size)
+        {
+            if (size > ReleasableSize())
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientPeeked, size, ReleasableSize());
+            }
+
+            const auto result = AdvanceRelease(size);
+            if (!result.has_value())
+            {
+                ErrorPolicy::Raise(result.error(), size, ReleasableSize());
+            }
+        }
+
+        // Release a block returned by PeekBlock, in any order and from any thread.  The space is returned to the
+        // producers once every block peeked before it has also been released.
+        // The error policy is raised if the block is not an outstanding peek, or if it would complete ahead of an
+        // older block while every slot is in use.
+        void Release(const DataBlock& dataBlock)
+        {
+            const auto result = AdvanceRelease(dataBlock);
+            if (!result.has_value())
+            {
+                ErrorPolicy::Raise(result.error(), dataBlock.size(), ReleasableSize());
+            }
+        }
+
+        // Non-throwing versions of the calls above, see NoCopyRingFifo.
+        std::expected<DataBlock, FifoError> TryReserve(size_t size)
+        {
+            DataBlock dataBlock;
+            if (!AdvanceReserve(size, dataBlock))
+            {
+                return std::unexpected(FifoError::InsufficientSpace);
+            }
+
+            return dataBlock;
+        }
+
+        std::expected<void, FifoError> TryCommit(const DataBlock& dataBlock)
+        {
+            return AdvanceCommit(dataBlock);
+        }
+
+        std::expected<DataBlock, FifoError> TryReadBlock(size_t size)
+        {
+            if (!HasReadableData(size))
+            {
+                return std::unexpected(FifoError::InsufficientData);
+            }
+
+            return AdvanceRead(size);
+        }
+
+        std::expected<DataBlock, FifoError> TryPeekBlock(size_t size)
+        {
+            if (!HasReadableData(size))
+            {
+                return std::unexpected(FifoError::InsufficientData);
+            }
+
+            return AdvancePeek(size);
+        }
+
+        std::expected<void, FifoError> TryRelease(size_t size)
+        {
+            if (size > ReleasableSize())
+            {
+                return std::unexpected(FifoError::InsufficientPeeked);
+            }
+
+            return AdvanceRelease(size);
+        }
+
+        std::expected<void, FifoError> TryRelease(const DataBlock& dataBlock)
+        {
+            return AdvanceRelease(dataBlock);
+        }
+
+        std::expected<DataBlock, FifoError> TryReserve(size_t size, std::chrono::nanoseconds timeout)
+        {
+            DataBlock dataBlock;
+            if (!WaitReserve(size, timeout, dataBlock))
+            {
+                return std::unexpected(FifoError::InsufficientSpace);
+            }
+
+            return dataBlock;
+        }
+
+        std::expected<DataBlock, FifoError> TryReadBlock(size_t size, std::chrono::nanoseconds timeout)
+        {
+            if (!WaitForData(size, timeout))
+            {
+                return std::unexpected(FifoError::InsufficientData);
+            }
+
+            return AdvanceRead(size);
+        }
+
+        std::expected<DataBlock, FifoError> TryPeekBlock(size_t size, std::chrono::nanoseconds timeout)
+        {
+            if (!WaitForData(size, timeout))
+            {
+                return std::unexpected(FifoError::InsufficientData);
+            }
+
+            return AdvancePeek(size);
+        }
+
+        std::expected<DataBlock, FifoError> TryReserveUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            DataBlock dataBlock;
+            if (!AdvanceReserveUpTo(size, minSize, upTo, dataBlock))
+            {
+                return std::unexpected(FifoError::InsufficientSpace);
+            }
+
+            return dataBlock;
+        }
+
+        std::expected<DataBlock, FifoError> TryReadUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            const size_t blockSize = ReadUpToSize(size, upTo);
+            if (blockSize < minSize)
+            {
+                return std::unexpected(FifoError::InsufficientData);
+            }
+
+            return AdvanceRead(blockSize);
+        }
+
+        std::expected<DataBlock, FifoError> TryPeekUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            const size_t blockSize = ReadUpToSize(size, upTo);
+            if (blockSize < minSize)
+            {
+                return std::unexpected(FifoError::InsufficientData);
+            }
+
+            return AdvancePeek(blockSize);
+        }
+
+        // Reset the FIFO to empty.  Not thread safe.
+        void Reset(void)
+        {
+            _reserveCursor.store(0, std::memory_order_relaxed);
+            _cachedReadCursor.store(0, std::memory_order_relaxed);
+            _commitCursor.Reset();
+            _peekCursor.store(0, std::memory_order_relaxed);
+            _cachedCommitCursor = 0;
+            _readCursor.Reset();
+        }
+
+        const size_t maxSize;
+
+    private:
+        // Check for data against the consumer's cached copy of the commit cursor, and only load the commit cursor
+        // when the copy says there is not enough.
+        inline bool HasReadableData(size_t size) const
+        {
+            return ((size <= (_cachedCommitCursor - _peekCursor.load(std::memory_order_relaxed))) || (size <= ReadableSize()));
+        }
+
+        // Claim space for a reservation, retrying if another producer claims space first.  Returns false if there
+        // is insufficient reservable space.
+        //
+        // Space is checked against the producers' cached copy of the read cursor first, and the read cursor itself is
+        // only loaded when the copy says the FIFO is too full.  Another producer may have stored an older copy, so the
+        // check is written so that a reserve cursor more than a FIFO length past it cannot wrap around.
+        inline bool AdvanceReserve(size_t size, DataBlock& dataBlock)
+        {
+            uint64_t reserveCursor = _reserveCursor.load(std::memory_order_relaxed);
+            uint64_t readCursor = _cachedReadCursor.load(std::memory_order_acquire);
+
+            do
+            {
+                if ((reserveCursor + size) > (readCursor + maxSize))
+                {
+                    readCursor = _readCursor.Load(std::memory_order_acquire);
+                    if ((reserveCursor + size) > (readCursor + maxSize))
+                    {
+                        return false;
+                    }
+
+                    _cachedReadCursor.store(readCursor, std::memory_order_release);
+                }
+            } while (!_reserveCursor.compare_exchange_weak(reserveCursor, (reserveCursor + size), std::memory_order_relaxed));
+
+            dataBlock = GetDataBlock((reserveCursor % maxSize), size);
+            dataBlock.sequence = reserveCursor;
+
+            return true;
+        }
+
+        // Claim as much space as is available for an up-to reservation, retrying if another producer claims space
+        // first.  Returns false if less than minSize elements are available.  The read cursor is only loaded when the
+        // producers' cached copy of it limits the block, as in AdvanceReserve.
+        inline bool AdvanceReserveUpTo(size_t size, size_t minSize, UpTo upTo, DataBlock& dataBlock)
+        {
+            uint64_t reserveCursor = _reserveCursor.load(std::memory_order_relaxed);
+            uint64_t readCursor = _cachedReadCursor.load(std::memory_order_acquire);
+            size_t blockSize = 0;
+
+            do
+            {
+                const size_t limit = UpToSize(size, upTo, maxSize, (maxSize - (reserveCursor % maxSize)));
+
+                blockSize = std::min(limit, SpaceAfter(reserveCursor, readCursor));
+                if (blockSize < limit)
+                {
+                    readCursor = _readCursor.Load(std::memory_order_acquire);
+                    blockSize = std::min(limit, SpaceAfter(reserveCursor, readCursor));
+                    _cachedReadCursor.store(readCursor, std::memory_order_release);
+                }
+
+                if (blockSize < minSize)
+                {
+                    return false;
+                }
+            } while (!_reserveCursor.compare_exchange_weak(reserveCursor, (reserveCursor + blockSize), std::memory_order_relaxed));
+
+            dataBlock = GetDataBlock((reserveCursor % maxSize), blockSize);
+            dataBlock.sequence = reserveCursor;
+
+            return true;
+        }
+
+        // Free space after a reserve cursor for a copy of the read cursor, which may be stale enough that the reserve
+        // cursor is more than a FIFO length past it.
+        inline size_t SpaceAfter(uint64_t reserveCursor, uint64_t readCursor) const
+        {
+            return (((readCursor + maxSize) > reserveCursor) ? static_cast<size_t>((readCursor + maxSize) - reserveCursor) : 0);
+        }
+
+        inline size_t ReadUpToSize(size_t size, UpTo upTo) const
+        {
+            const uint64_t peekCursor = _peekCursor.load(std::memory_order_relaxed);
+            const size_t limit = UpToSize(size, upTo, maxSize, (maxSize - (peekCursor % maxSize)));
+            const size_t cached = (_cachedCommitCursor - peekCursor);
+
+            return std::min(limit, ((cached >= limit) ? cached : ReadableSize()));
+        }
+
+        // Commit a reserved block.  Fails if the block is not an outstanding reservation, or has to be parked and
+        // every slot is in use.
+        inline std::expected<void, FifoError> AdvanceCommit(const DataBlock& dataBlock)
+        {
+            const uint64_t start = dataBlock.sequence;
+            const uint64_t end = (start + dataBlock.size());
+
+            if ((start < _commitCursor.Load(std::memory_order_relaxed)) ||
+                (end > _reserveCursor.load(std::memory_order_relaxed)) ||
+                _commitCursor.Parked(start))
+            {
+                return std::unexpected(FifoError::InsufficientReserved);
+            }
+
+            if (!_commitCursor.Complete(start, end))
+            {
+                return std::unexpected(FifoError::TooManyOutOfOrder);
+            }
+
+            _dataWait.Notify();
+
+            return {};
+        }
+
+        // Commit the start of a reserved block and move the reserve cursor back over the rest.  Fails if the block is
+        // not an outstanding reservation or has already been committed, the reserve cursor has moved past it, or it
+        // may have to be parked and every slot is in use.  The slot is claimed before the reserve cursor moves, so the commit cannot fail after it.
+        inline std::expected<void, FifoError> AdvanceCommitAndUnreserve(const DataBlock& dataBlock, size_t size)
+        {
+            const uint64_t start = dataBlock.sequence;
+            uint64_t end = (start + dataBlock.size());
+            const uint64_t commitCursor = _commitCursor.Load(std::memory_order_relaxed);
+
+            // As for Commit, the block must lie in the reserved space and not have been committed already.
+            if ((size > dataBlock.size()) ||
+                (start < commitCursor) ||
+                (end > _reserveCursor.load(std::memory_order_relaxed)) ||
+                _commitCursor.Parked(start))
+            {
+                return std::unexpected(FifoError::InsufficientReserved);
+            }
+
+            const auto slot = ClaimUnlessAtCursor(_commitCursor, (start == commitCursor));
+            if (!slot.has_value())
+            {
+                return std::unexpected(FifoError::TooManyOutOfOrder);
+            }
+
+            if (size < dataBlock.size())
+            {
+                if (!_reserveCursor.compare_exchange_strong(end, (start + size), std::memory_order_relaxed))
+                {
+                    _commitCursor.Unclaim(*slot);
+
+                    return std::unexpected(FifoError::InsufficientReserved);
+                }
+
+                _spaceWait.Notify();
+            }
+
+            _commitCursor.Complete(start, (start + size), *slot);
+            _dataWait.Notify();
+
+            return {};
+        }
+
+        // Peek a block and release it straight away.  A block read while earlier peeks are outstanding is parked, so
+        // a slot is claimed first and the read fails without peeking if there is none.
+        inline std::expected<DataBlock, FifoError> AdvanceRead(size_t size)
+        {
+            const auto slot = ClaimUnlessAtCursor(_readCursor, (ReleasableSize() == 0));
+            if (!slot.has_value())
+            {
+                return std::unexpected(FifoError::TooManyOutOfOrder);
+            }
+
+            DataBlock dataBlock = AdvancePeek(size);
+            _readCursor.Complete(dataBlock.sequence, (dataBlock.sequence + size), *slot);
+            _spaceWait.Notify();
+
+            return dataBlock;
+        }
+
+        // Claim a slot for a block that may have to be parked, or none for a block at the cursor, which no other
+        // block can move the cursor past.  Returns nothing if a slot is needed and every slot is in use.
+        static std::optional<size_t> ClaimUnlessAtCursor(CompletionCursor& cursor, bool atCursor)
+        {
+            const size_t slot = (atCursor ? CompletionCursor::noSlot : cursor.Claim());
+            if (!atCursor && (slot == CompletionCursor::noSlot))
+            {
+                return std::nullopt;
+            }
+
+            return slot;
+        }
+
+
+        inline DataBlock RaiseOnError(std::expected<DataBlock, FifoError>&& dataBlock, size_t size)
+        {
+            if (!dataBlock.has_value())
+            {
+                ErrorPolicy::Raise(dataBlock.error(), size, ReleasableSize());
+            }
+
+            return *dataBlock;
+        }
+
+        inline DataBlock AdvancePeek(size_t size)
+        {
+            const uint64_t peekCursor = _peekCursor.load(std::memory_order_relaxed);
+
+            DataBlock dataBlock = GetDataBlock((peekCursor % maxSize), size);
+            dataBlock.sequence = peekCursor;
+            _peekCursor.store((peekCursor + size), std::memory_order_relaxed);
+
+            return dataBlock;
+        }
+
+        // Release the oldest peeked elements.  This only fails if blocks are also being released individually.
+        inline std::expected<void, FifoError> AdvanceRelease(size_t size)
+        {
+            const uint64_t readCursor = _readCursor.Load(std::memory_order_relaxed);
+            if (!_readCursor.Complete(readCursor, (readCursor + size)))
+            {
+                return std::unexpected(FifoError::TooManyOutOfOrder);
+            }
+
+            _spaceWait.Notify();
+
+            return {};
+        }
+
+        // Release a peeked block.  Fails if the block is not an outstanding peek, or has to be parked and every slot
+        // is in use.
+        inline std::expected<void, FifoError> AdvanceRelease(const DataBlock& dataBlock)
+        {
+            const uint64_t start = dataBlock.sequence;
+            const uint64_t end = (start + dataBlock.size());
+
+            if ((start < _readCursor.Load(std::memory_order_relaxed)) ||
+                (end > _peekCursor.load(std::memory_order_relaxed)) ||
+                _readCursor.Parked(start))
+            {
+                return std::unexpected(FifoError::InsufficientPeeked);
+            }
+
+            if (!_readCursor.Complete(start, end))
+            {
+                return std::unexpected(FifoError::TooManyOutOfOrder);
+            }
+
+            _spaceWait.Notify();
+
+            return {};
+        }
+
+        // Reserve for a blocking call, waiting for space until the reservation succeeds.  Returns false on timeout, or
+        // if the size is larger than the FIFO.
+        bool WaitReserve(size_t size, std::chrono::nanoseconds timeout, DataBlock& dataBlock)
+        {
+            if (size > maxSize)
+            {
+                return false;
+            }
+
+            const WaitClock::time_point deadline = WaitDeadline(timeout);
+
+            while (!AdvanceReserve(size, dataBlock))
+            {
+                if (!_spaceWait.Wait([&] { return (size <= ReservableSize()); }, deadline))
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        bool WaitForData(size_t size, std::chrono::nanoseconds timeout)
+        {
+            return ((size <= maxSize) &&
+                _dataWait.Wait([&] { return HasReadableData(size); }, WaitDeadline(timeout)));
+        }
+
+        // Get a block of data starting at the specified buffer position.
+        DataBlock GetDataBlock(size_t position, size_t size)
+        {
+            if (size == 0)
+            {
+                return DataBlock();
+            }
+
+            const size_t remainingBufferSize = (maxSize - position);
+
+            if (size > remainingBufferSize)
+            {
+                return DataBlock(
+                    _ringBufferSpan.subspan(position, remainingBufferSize),
+                    _ringBufferSpan.subspan(0, (size - remainingBufferSize))
+                    );
+            }
+            else
+            {
+                return DataBlock(_ringBufferSpan.subspan(position, size));
+            }
+        }
+
+        std::vector<T> _ringBuffer;
+        std::span<T> _ringBufferSpan;
+
+        // Shared producer state, with the producers' copy of the read cursor.
+        alignas(cacheLineSize) std::atomic<uint64_t> _reserveCursor = 0;
+        std::atomic<uint64_t> _cachedReadCursor = 0;
+
+        // Moved by whichever thread completes the oldest outstanding reservation, read by the consumer.
+        CompletionCursor _commitCursor;
+
+        // Written by the consumer only, but read by threads releasing blocks to check them.  The consumer's copy of
+        // the commit cursor shares the line.
+        alignas(cacheLineSize) std::atomic<uint64_t> _peekCursor = 0;
+        mutable uint64_t _cachedCommitCursor = 0;
+
+        // Moved by whichever thread releases the oldest outstanding peek, read by the producers.
+        CompletionCursor _readCursor;
+
+        // The consumer waits for data on one wait strategy object and blocked producers for space on the other.
+        alignas(cacheLineSize) WaitStrategy _dataWait;
+        WaitStrategy _spaceWait;
+    };
+}
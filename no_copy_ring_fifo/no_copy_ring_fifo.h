@@ -10,152 +10,1550 @@
 *
 *   Once data is comitted to the FIFO, it is immediately available to read.
 *
+*   Reading can also happen in 2 stages - a block of committed data is peeked, and the space is only released back to
+*   the FIFO once the user is done with it.  This keeps the memory from being recycled while an asynchronous write
+*   out of the block is still in flight.
+*
 *   The underlying memory is a single contiguous block, and read and write operations wrap around the ends.  It is
 *   therefore possible that a read or write could involve two different copy operations on seperate sections of memory.
-*   The DataBlock class defined here contains two spans to cover the case of a wraparound.
+*   The DataBlock class defined here contains two spans to cover the case of a wraparound.  The buffer memory comes
+*   from a storage class template parameter, and a mirrored storage (see mirrored_storage.h) removes the split case.
+*
+*   The FIFO state is four free-running 64-bit cursors - reserve, commit, peek and read - and every size is the
+*   distance between two of them.  A cursor's buffer position is the cursor wrapped by the capacity policy, and each
+*   DataBlock carries the cursor it started at as its stream offset.  Peeked data lies between the read and peek
+*   cursors, and ReadBlock frees its block by moving the read cursor past it, which would free the peeked data too.
+*   ReadBlock and ReadUpTo therefore raise FifoError::PeekOutstanding (std::logic_error by default) until every peeked
+*   block has been released, so a consumer either releases its peeks before reading or peeks throughout.
+*
+*   ReserveContiguous is a bip-buffer style reserve for consumers that need a single span.  A block that would split is
+*   moved to the start of the buffer instead, and the elements skipped at the end are stepped over by the other cursors
+*   and counted in the FIFO statistics.
+*
+*   SpscNoCopyRingFifo provides the same reserve/commit/read contract for one producer thread and one consumer thread
+*   without any locking.  The producer owns the write cursors and the consumer owns the read cursor, each on its own
+*   cache line, and the two sides synchronise through acquire/release atomics.  Each side keeps a cached copy of the
+*   other side's cursor, so it only touches the other side's cache line when the FIFO looks full or empty.  Reserve,
+*   ReadBlock and PeekBlock also have blocking overloads with a timeout, which wait for the other side to make space
+*   or commit data using the WaitStrategy template parameter (see wait_strategy.h).
 */
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdlib>
 #include <cstring>
 #include <cstdint>
+#include <bit>
 #include <span>
 #include <vector>
 #include <format>
+#include <atomic>
+#include <chrono>
+#include <expected>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#endif
+
+#include "wait_strategy.h"
 
 namespace FifoTemplates
 {
-    template <typename T> class NoCopyRingFifo
+#ifdef __cpp_lib_hardware_interference_size
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winterference-size"
+#endif
+    inline constexpr size_t cacheLineSize = std::hardware_destructive_interference_size;
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#else
+    inline constexpr size_t cacheLineSize = 64;
+#endif
+
+    // Class to hold spans used to view or copy a block of data in the FIFO.
+    // A read or write to the FIFO may be split between 2 spans if it wraps around the end of the buffer.
+    template <typename T> class DataBlock
     {
     public:
-        
-        // Class to hold spans used to view or copy a block of data in the FIFO.
-        // A read or write to the FIFO may be split between 2 spans if it wraps around the end of the buffer.
-        class DataBlock
+        using element_type = T;
+
+        DataBlock() : spans{ std::span<T>(), std::span<T>() } {}
+        DataBlock(std::span<T>&& span0) : spans{ span0, std::span<T>() } {}
+        DataBlock(std::span<T>&& span0, std::span<T>&& span1) : spans{ span0, span1 } {}
+
+        inline bool isSplit(void) const { return (spans[1].empty() == false); }
+        inline bool isValid(void) const { return (spans[0].empty() == false); }
+        inline size_t size(void) const { return (spans[0].size() + spans[1].size()); }
+
+        std::span<T> spans[2];
+
+        // Free-running stream position of the first element of the block, counted in elements from the last Reset.
+        // Reserved blocks are numbered in the write stream and read blocks in the read stream, so a block keeps the
+        // same sequence from Reserve through to ReadBlock.  Elements skipped by ReserveContiguous are counted.
+        uint64_t sequence = 0;
+    };
+
+    // Default FIFO storage, a std::vector holding one copy of the buffer, allocated through an optional allocator.
+    //
+    // A storage class provides its FIFO size through Size() and a span of the buffer through Span().  If isMirrored is
+    // true, the span is twice the FIFO size and its second half maps the same memory as the first, so a block that
+    // runs past the end of the buffer can be returned as one contiguous span.  Storage classes that allocate are
+    // constructible from the FIFO size, and any storage object can be moved into the FIFO's storage constructor.
+    template <typename T, typename Allocator = std::allocator<T>> class VectorStorage
+    {
+    public:
+        static constexpr bool isMirrored = false;
+
+        VectorStorage(size_t size, const Allocator& allocator = Allocator()) : _buffer(allocator) { _buffer.resize(size); }
+
+        inline size_t Size(void) const { return _buffer.size(); }
+        inline std::span<T> Span(void) { return std::span<T>(_buffer); }
+
+    private:
+        std::vector<T, Allocator> _buffer;
+    };
+
+    // Non-owning FIFO storage over a span of memory that the caller owns, such as a hugepage arena or a region
+    // registered for DMA.  The memory must outlive the FIFO.
+    template <typename T> class SpanStorage
+    {
+    public:
+        static constexpr bool isMirrored = false;
+
+        SpanStorage(std::span<T> buffer) : _buffer(buffer) {}
+
+        inline size_t Size(void) const { return _buffer.size(); }
+        inline std::span<T> Span(void) { return _buffer; }
+
+    private:
+        std::span<T> _buffer;
+    };
+
+    // Fixed-size FIFO storage held inline in a std::array, for FIFOs in static objects or on the stack.
+    template <typename T, size_t N> class ArrayStorage
+    {
+    public:
+        static constexpr bool isMirrored = false;
+
+        ArrayStorage(void) = default;
+        ArrayStorage(size_t size)
+        {
+            if (size != N)
+            {
+                throw std::invalid_argument(
+                    std::format("Array FIFO size is fixed - requested {}, array size {}", size, N)
+                    );
+            }
+        }
+
+        inline size_t Size(void) const { return N; }
+        inline std::span<T> Span(void) { return std::span<T>(_buffer); }
+
+    private:
+        std::array<T, N> _buffer{};
+    };
+
+    // FIFO storage that default-initialises its elements instead of value-initialising them.  For trivially
+    // constructible types the memory is left untouched, so the pages of a large buffer are only faulted in as the FIFO
+    // first writes to them.  Use Prefault to fault them in up front instead.
+    template <typename T> class UninitializedStorage
+    {
+    public:
+        static constexpr bool isMirrored = false;
+
+        UninitializedStorage(size_t size) : _buffer(std::make_unique_for_overwrite<T[]>(size)), _size(size) {}
+
+        inline size_t Size(void) const { return _size; }
+        inline std::span<T> Span(void) { return std::span<T>(_buffer.get(), _size); }
+
+    private:
+        std::unique_ptr<T[]> _buffer;
+        size_t _size;
+    };
+
+    // Default capacity policy, the FIFO size is used as requested and indexes wrap with a modulo.
+    //
+    // A capacity policy chooses the FIFO size for a requested size with Capacity(), and is then constructed from that
+    // size to report it through Size() and wrap free-running cursors to buffer positions with Wrap().
+    class ModuloCapacity
+    {
+    public:
+        static inline size_t Capacity(size_t size) { return size; }
+
+        ModuloCapacity(size_t capacity) : _capacity(capacity) {}
+
+        inline size_t Size(void) const { return _capacity; }
+        inline size_t Wrap(uint64_t cursor) const { return static_cast<size_t>(cursor % _capacity); }
+
+    private:
+        size_t _capacity;
+    };
+
+    // Capacity policy that rounds the FIFO size up to a power of two, so indexes wrap with a mask instead of an
+    // integer division.
+    class PowerOfTwoCapacity
+    {
+    public:
+        static inline size_t Capacity(size_t size) { return std::bit_ceil(size); }
+
+        PowerOfTwoCapacity(size_t capacity) : _mask(capacity - 1) {}
+
+        inline size_t Size(void) const { return (_mask + 1); }
+        inline size_t Wrap(uint64_t cursor) const { return static_cast<size_t>(cursor & _mask); }
+
+    private:
+        size_t _mask;
+    };
+
+    // Capacity policy for a FIFO size fixed at compile time.  The size is a constant in the wrap and space
+    // arithmetic, and wrapping uses a mask when N is a power of two.
+    template <size_t N> class FixedCapacity
+    {
+    public:
+        static_assert(N > 0, "Fixed FIFO capacity must be greater than zero");
+
+        static constexpr size_t staticCapacity = N;
+
+        static inline size_t Capacity(size_t size)
         {
-        public:
-            DataBlock() : spans{ std::span<T>(), std::span<T>() } {}
-            DataBlock(std::span<T>&& span0) : spans{ span0, std::span<T>() } {}
-            DataBlock(std::span<T>&& span0, std::span<T>&& span1) : spans{ span0, span1 } {}
+            if (size != N)
+            {
+                throw std::invalid_argument(
+                    std::format("Fixed FIFO size cannot change - requested {}, fixed size {}", size, N)
+                    );
+            }
 
-            inline bool isSplit(void) const { return (spans[1].empty() == false); }
-            inline bool isValid(void) const { return (spans[0].empty() == false); }
+            return N;
+        }
 
-            std::span<T> spans[2];
-        };
+        FixedCapacity(size_t) {}
 
-        NoCopyRingFifo(size_t size) : maxSize(size)
+        static constexpr size_t Size(void) { return N; }
+        static constexpr size_t Wrap(uint64_t cursor)
         {
-            _ringBuffer.resize(size);
-            _ringBufferSpan = std::span<T>(_ringBuffer);
+            if constexpr (std::has_single_bit(N))
+            {
+                return static_cast<size_t>(cursor & (N - 1));
+            }
+            else
+            {
+                return static_cast<size_t>(cursor % N);
+            }
         }
+    };
 
-        // Reserve a block of FIFO memory, returning a FifoBlock object.
-        // An exception is thrown if there is insufficient reservable space.
-        DataBlock Reserve(size_t size)
+    // Reasons a FIFO call can fail.
+    enum class FifoError
+    {
+        InsufficientSpace,      // Reserve larger than the reservable space.
+        InsufficientReserved,   // Commit larger than the reserved space.
+        InsufficientData,       // Read or peek larger than the committed data.
+        InsufficientPeeked,     // Release larger than the peeked data.
+        PeekOutstanding,        // Read while peeked data has not been released.
+        TooManyOutOfOrder       // Block completed ahead of an older one while every completion slot is in use.
+    };
+
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+    // Error policy that throws std::overflow_error for reserve and commit failures and for running out of completion
+    // slots, std::underflow_error for read and release failures and std::logic_error for a read while peeked data is
+    // outstanding.
+    class ThrowErrorPolicy
+    {
+    public:
+        [[noreturn]] static void Raise(FifoError error, size_t requested, size_t available)
         {
-            if (size > ReservableSize())
+            switch (error)
             {
+            case FifoError::InsufficientSpace:
                 throw std::overflow_error(
                     std::format("Not enough free space in FIFO for reserve - requested {}, available {}",
-                    size,
-                    ReservableSize())
+                    requested,
+                    available)
+                    );
+            case FifoError::InsufficientReserved:
+                throw std::overflow_error(
+                    std::format("Not enough reserved space in FIFO for commit - requested {}, available {}",
+                    requested,
+                    available)
+                    );
+            case FifoError::InsufficientData:
+                throw std::underflow_error(
+                    std::format("Read larger than committed size - requested {}, available {}", requested, available)
+                    );
+            case FifoError::PeekOutstanding:
+                throw std::logic_error(
+                    std::format("Read while peeked data is outstanding - requested {}, peeked {}", requested, available)
+                    );
+            case FifoError::TooManyOutOfOrder:
+                throw std::overflow_error(
+                    std::format("Too many blocks completed out of order - requested {}, outstanding {}",
+                    requested,
+                    available)
+                    );
+            case FifoError::InsufficientPeeked:
+            default:
+                throw std::underflow_error(
+                    std::format("Release larger than peeked size - requested {}, available {}", requested, available)
+                    );
+            }
+        }
+    };
+#endif
+
+    // Error policy for builds without exceptions.  A failed call is treated as a program error - it asserts in debug
+    // builds and aborts.  Callers that expect full or empty FIFOs should use the Try calls instead.
+    class AbortErrorPolicy
+    {
+    public:
+        [[noreturn]] static void Raise([[maybe_unused]] FifoError error, size_t, size_t)
+        {
+            assert(!"NoCopyRingFifo call failed");
+            std::abort();
+        }
+    };
+
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+    using DefaultErrorPolicy = ThrowErrorPolicy;
+#else
+    using DefaultErrorPolicy = AbortErrorPolicy;
+#endif
+
+    // Counters of capacity lost to contiguous reserves.
+    struct FifoStatistics
+    {
+        uint64_t skips = 0;             // Contiguous reserves that skipped the end of the buffer.
+        uint64_t skippedElements = 0;   // Elements left unused at the end of the buffer by those reserves.
+    };
+
+    // Which part of the free space or readable data an up-to call takes.
+    enum class UpTo
+    {
+        Available,      // Everything available up to the requested size, which may be split.
+        Contiguous      // Only what is available before the end of the buffer, so the block is never split.
+    };
+
+    // Size of the block for an up-to call, given what is available and how much of it lies before the end of the
+    // buffer.
+    inline size_t UpToSize(size_t size, UpTo upTo, size_t available, size_t contiguous)
+    {
+        return std::min({ size, available, ((upTo == UpTo::Contiguous) ? contiguous : available) });
+    }
+
+    // Whether the first size elements of a block can be committed or released with the rest handed back, given the
+    // oldest and newest outstanding cursors on that side of the FIFO.  Commits and releases are in order, so taking
+    // any of the block needs it to be the oldest outstanding block, and handing any of it back needs it to be the
+    // newest, as the space after it belongs to the blocks after it.  An empty block has nothing to take or hand back.
+    template <typename T>
+    inline bool CanHandBack(const DataBlock<T>& dataBlock, size_t size, uint64_t oldest, uint64_t newest)
+    {
+        const uint64_t end = (dataBlock.sequence + dataBlock.size());
+
+        if (dataBlock.size() == 0)
+        {
+            return (size == 0);
+        }
+
+        return ((size <= dataBlock.size()) && (dataBlock.sequence >= oldest) && (end <= newest) &&
+            ((size == 0) || (dataBlock.sequence == oldest)) && ((size == dataBlock.size()) || (end == newest)));
+    }
+
+    template <
+        typename T,
+        typename Storage = VectorStorage<T>,
+        typename CapacityPolicy = ModuloCapacity,
+        typename ErrorPolicy = DefaultErrorPolicy>
+    class NoCopyRingFifo
+    {
+    public:
+        using DataBlock = FifoTemplates::DataBlock<T>;
+
+        NoCopyRingFifo(size_t size) :
+            maxSize(CapacityPolicy::Capacity(size)),
+            _ringBuffer(maxSize),
+            _capacity(maxSize)
+        {
+            _ringBufferSpan = _ringBuffer.Span();
+        }
+
+        // Construct a FIFO with a fixed capacity at its compile-time size.
+        NoCopyRingFifo(void) requires requires { CapacityPolicy::staticCapacity; } :
+            NoCopyRingFifo(CapacityPolicy::staticCapacity)
+        {
+        }
+
+        // Construct the FIFO over an existing storage object, for example a SpanStorage over caller-owned memory.
+        // The FIFO size is the storage size, which must already suit the capacity policy.
+        explicit NoCopyRingFifo(Storage&& storage) :
+            maxSize(storage.Size()),
+            _ringBuffer(std::move(storage)),
+            _capacity(maxSize)
+        {
+            if (CapacityPolicy::Capacity(maxSize) != maxSize)
+            {
+                throw std::invalid_argument(
+                    std::format("Storage size does not suit the FIFO capacity policy - size {}, nearest {}",
+                    maxSize,
+                    CapacityPolicy::Capacity(maxSize))
                     );
             }
 
-            _reserved += size;
+            _ringBufferSpan = _ringBuffer.Span();
+        }
+
+        // The FIFO hands out spans into its own storage, so a copy would alias the original's buffer.
+        NoCopyRingFifo(const NoCopyRingFifo&) = delete;
+        NoCopyRingFifo& operator=(const NoCopyRingFifo&) = delete;
+
+        // Reserve a block of FIFO memory, returning a FifoBlock object.
+        // The error policy is raised if there is insufficient reservable space.
+        DataBlock Reserve(size_t size)
+        {
+            if (size > ReservableSize())
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientSpace, size, ReservableSize());
+            }
 
-            return GetDataBlock(_writeIndex, size);
+            return AdvanceReserve(size);
         }
 
         // Commit a block of data to the FIFO.  This increases the amount of committed data that is
         // available to be read and decreases the amount of reserved data, both by the commit size.
-        // An exception is throw if there is insufficient reserved space for the commit.
+        // The error policy is raised if there is insufficient reserved space for the commit.
         void Commit(size_t size)
         {
             if (size > CommitableSize())
             {
-                throw std::overflow_error(
-                    std::format("Not enough reserved space in FIFO for commit - requested {}, available {}", 
-                    size,
-                    CommitableSize()
-                    )
-                    );
+                ErrorPolicy::Raise(FifoError::InsufficientReserved, size, CommitableSize());
+            }
+
+            AdvanceCommit(size);
+        }
+
+        // The sizes are the distances between consecutive cursors.  Elements skipped by ReserveContiguous take up
+        // reservable space until they are released, but are not counted in the other sizes.
+        inline size_t ReservableSize(void) const { return (_capacity.Size() - (_reserveCursor - _readCursor)); }
+        inline size_t CommitableSize(void) const { return Distance(_commitCursor, _reserveCursor); }
+        inline size_t ReadableSize(void) const { return Distance(_peekCursor, _commitCursor); }
+        inline size_t ReleasableSize(void) const { return Distance(_readCursor, _peekCursor); }
+
+        // Reserve a block that is always a single span.  If the block does not fit between the reserve position and
+        // the end of the buffer, the rest of the buffer is skipped and the block starts at the beginning.  The skipped
+        // elements are stepped over by every later call, so commits, reads and releases carry on by size as usual,
+        // and they are returned to the reservable space once the data before them has been released.
+        // The error policy is raised if there is no contiguous space for the block.
+        DataBlock ReserveContiguous(size_t size)
+        {
+            if (size > ContiguousReservableSize())
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientSpace, size, ContiguousReservableSize());
+            }
+
+            return AdvanceReserveContiguous(size);
+        }
+
+        std::expected<DataBlock, FifoError> TryReserveContiguous(size_t size)
+        {
+            if (size > ContiguousReservableSize())
+            {
+                return std::unexpected(FifoError::InsufficientSpace);
+            }
+
+            return AdvanceReserveContiguous(size);
+        }
+
+        // Largest block ReserveContiguous can return, either before the end of the buffer or after skipping it.
+        size_t ContiguousReservableSize(void) const
+        {
+            const size_t reservable = ReservableSize();
+            if constexpr (Storage::isMirrored)
+            {
+                return reservable;
+            }
+
+            const size_t tail = (_capacity.Size() - _capacity.Wrap(_reserveCursor));
+
+            return ((reservable <= tail) ? reservable : std::max(tail, (reservable - tail)));
+        }
+
+        // Reserve as much space as is available, up to size elements, in one call.  The block's size is the size
+        // reserved, and a full FIFO returns an empty block.  With UpTo::Contiguous, only the space before the end of
+        // the buffer is reserved.
+        // The error policy is raised if less than minSize elements can be reserved.
+        DataBlock ReserveUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            const size_t blockSize = UpToSize(size, upTo, ReservableSize(), ContiguousSize(_reserveCursor));
+            if (blockSize < minSize)
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientSpace, minSize, blockSize);
+            }
+
+            return AdvanceReserve(blockSize);
+        }
+
+        // Read or peek as much committed data as is available, up to size elements, in one call.  An empty FIFO
+        // returns an empty block.
+        // The error policy is raised if less than minSize elements can be read.
+        DataBlock ReadUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            if (PeekOutstanding())
+            {
+                ErrorPolicy::Raise(FifoError::PeekOutstanding, size, ReleasableSize());
+            }
+
+            const size_t blockSize = ReadUpToSize(size, upTo);
+            if (blockSize < minSize)
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientData, minSize, blockSize);
+            }
+
+            return AdvanceRead(blockSize);
+        }
+
+        DataBlock PeekUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            const size_t blockSize = ReadUpToSize(size, upTo);
+            if (blockSize < minSize)
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientData, minSize, blockSize);
             }
 
-            _committed += size;
-            _reserved -= size;
+            return AdvancePeek(blockSize);
         }
 
-        inline size_t ReservableSize(void) const { return (_ringBuffer.size() - (_reserved + _committed)); }
-        inline size_t CommitableSize(void) const { return _reserved; }
-        inline size_t ReadableSize(void) const { return _committed; }
+        // Counters of capacity lost to ReserveContiguous since the FIFO was constructed.
+        inline const FifoStatistics& Statistics(void) const { return _statistics; }
 
-        // Get a block of comitted data to read.
+        // Get a block of comitted data to read.  The block is freed immediately, so the data must be consumed before
+        // the next reserve.
+        // The error policy is raised if there is insufficient committed data for the read, or if peeked data has not
+        // been released, as freeing the block would free the peeked data with it.
         DataBlock ReadBlock(size_t size)
         {
-            if (size > _committed)
+            if (PeekOutstanding())
             {
-                throw std::underflow_error(
-                    std::format("Read larger than committed size - requested {}, available {}", size, _committed)
-                    );
+                ErrorPolicy::Raise(FifoError::PeekOutstanding, size, ReleasableSize());
+            }
+
+            if (size > ReadableSize())
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientData, size, ReadableSize());
             }
 
-            _committed -= size;
+            return AdvanceRead(size);
+        }
+
+        // Get a block of committed data to read without freeing it.  This is the read-side mirror of Reserve - the
+        // block stays out of the reservable space until it is handed back with Release, so it can be the source of
+        // an asynchronous write that completes later.
+        // The error policy is raised if there is insufficient committed data for the peek.
+        DataBlock PeekBlock(size_t size)
+        {
+            if (size > ReadableSize())
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientData, size, ReadableSize());
+            }
 
-            return GetDataBlock(_readIndex, size);
+            return AdvancePeek(size);
         }
 
-        void Reset(void)
+        // Release a block of peeked data, returning it to the reservable space.  Blocks are released in the order
+        // they were peeked.
+        // The error policy is raised if there is insufficient peeked data for the release.
+        void Release(size_t size)
         {
-            _readIndex = 0;
-            _writeIndex = 0;
-            _reserved = 0;
-            _committed = 0;
+            if (size > ReleasableSize())
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientPeeked, size, ReleasableSize());
+            }
+
+            AdvanceRelease(size);
         }
 
-        const size_t maxSize;
-        
-    private:
-        // Get a block of data starting at the specified index.  This is used by both the Reserve and ReadBlock functions.
-        DataBlock GetDataBlock(size_t& index, size_t size)
+        // Hand back the most recently reserved elements that have not been committed, for example the unused end of
+        // a block reserved for a read of unknown length.
+        // The error policy is raised if there is insufficient reserved space.
+        void Unreserve(size_t size)
         {
-            if (size > _ringBuffer.size())
+            if (size > CommitableSize())
             {
-                throw std::overflow_error(
-                    std::format("Requested span size larger than FIFO size - requested {}, available {}", 
-                    size,
-                    _ringBuffer.size()
-                    )
-                    );
+                ErrorPolicy::Raise(FifoError::InsufficientReserved, size, CommitableSize());
             }
-            else if (size == 0)
+
+            AdvanceUnreserve(size);
+        }
+
+        // Hand back the most recently peeked elements that have not been released, so they can be read again.
+        // The error policy is raised if there is insufficient peeked data.
+        void Unpeek(size_t size)
+        {
+            if (size > ReleasableSize())
             {
-                return DataBlock();
+                ErrorPolicy::Raise(FifoError::InsufficientPeeked, size, ReleasableSize());
             }
 
-            const size_t remainingBufferSize = (_ringBuffer.size() - index);
-            size_t oldIndex = index;
-            index = (index + size) % _ringBuffer.size();
+            _peekCursor = Retreat(_peekCursor, size);
+        }
 
-            if (size > remainingBufferSize)
+        // Commit the first size elements of a reserved block and hand back the rest of it in one call, for example
+        // after a read that returned less than was reserved for it.  Commits are in order, so a block can only be
+        // committed while it is the oldest outstanding reservation, and the rest only handed back while it is the
+        // most recent.  A size of zero hands back the whole block.
+        // The error policy is raised if the block is not an outstanding reservation, or is not the oldest or most
+        // recent one when the call needs it to be.
+        void CommitAndUnreserve(const DataBlock& dataBlock, size_t size)
+        {
+            if (!CanHandBack(dataBlock, size, _commitCursor, _reserveCursor))
             {
-                return DataBlock(
-                    _ringBufferSpan.subspan(oldIndex, remainingBufferSize),
-                    _ringBufferSpan.subspan(0, index)
-                    );
+                ErrorPolicy::Raise(FifoError::InsufficientReserved, dataBlock.size(), CommitableSize());
             }
-            else
+
+            AdvanceCommitAndUnreserve(dataBlock, size);
+        }
+
+        // Release the first size elements of a peeked block and hand back the rest of it, so it can be read again.
+        // As with CommitAndUnreserve, the block must be the oldest outstanding peek to release any of it, and the
+        // most recent to hand any of it back.
+        // The error policy is raised if the block is not an outstanding peek, or is not the oldest or most recent one
+        // when the call needs it to be.
+        void ReleaseAndUnpeek(const DataBlock& dataBlock, size_t size)
+        {
+            if (!CanHandBack(dataBlock, size, _readCursor, _peekCursor))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientPeeked, dataBlock.size(), ReleasableSize());
+            }
+
+            AdvanceReleaseAndUnpeek(dataBlock, size);
+        }
+
+        // Non-throwing versions of the calls above.  A full or empty FIFO is reported through the returned error
+        // rather than the error policy, and nothing is allocated.
+        std::expected<DataBlock, FifoError> TryReserve(size_t size)
+        {
+            if (size > ReservableSize())
             {
-                return DataBlock(_ringBufferSpan.subspan(oldIndex, size));
+                return std::unexpected(FifoError::InsufficientSpace);
             }
+
+            return AdvanceReserve(size);
         }
 
-        std::vector<T> _ringBuffer;
-        std::span<T> _ringBufferSpan;
-        size_t _readIndex = 0;
-        size_t _writeIndex = 0;
-        size_t _reserved = 0;
-        size_t _committed = 0;
+        std::expected<void, FifoError> TryCommit(size_t size)
+        {
+            if (size > CommitableSize())
+            {
+                return std::unexpected(FifoError::InsufficientReserved);
+            }
+
+            AdvanceCommit(size);
+
+            return {};
+        }
+
+        std::expected<DataBlock, FifoError> TryReadBlock(size_t size)
+        {
+            if (PeekOutstanding())
+            {
+                return std::unexpected(FifoError::PeekOutstanding);
+            }
+
+            if (size > ReadableSize())
+            {
+                return std::unexpected(FifoError::InsufficientData);
+            }
+
+            return AdvanceRead(size);
+        }
+
+        std::expected<DataBlock, FifoError> TryPeekBlock(size_t size)
+        {
+            if (size > ReadableSize())
+            {
+                return std::unexpected(FifoError::InsufficientData);
+            }
+
+            return AdvancePeek(size);
+        }
+
+        std::expected<void, FifoError> TryRelease(size_t size)
+        {
+            if (size > ReleasableSize())
+            {
+                return std::unexpected(FifoError::InsufficientPeeked);
+            }
+
+            AdvanceRelease(size);
+
+            return {};
+        }
+
+        std::expected<DataBlock, FifoError> TryReserveUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            const size_t blockSize = UpToSize(size, upTo, ReservableSize(), ContiguousSize(_reserveCursor));
+            if (blockSize < minSize)
+            {
+                return std::unexpected(FifoError::InsufficientSpace);
+            }
+
+            return AdvanceReserve(blockSize);
+        }
+
+        std::expected<DataBlock, FifoError> TryReadUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            if (PeekOutstanding())
+            {
+                return std::unexpected(FifoError::PeekOutstanding);
+            }
+
+            const size_t blockSize = ReadUpToSize(size, upTo);
+            if (blockSize < minSize)
+            {
+                return std::unexpected(FifoError::InsufficientData);
+            }
+
+            return AdvanceRead(blockSize);
+        }
+
+        std::expected<DataBlock, FifoError> TryPeekUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            const size_t blockSize = ReadUpToSize(size, upTo);
+            if (blockSize < minSize)
+            {
+                return std::unexpected(FifoError::InsufficientData);
+            }
+
+            return AdvancePeek(blockSize);
+        }
+
+        std::expected<void, FifoError> TryCommitAndUnreserve(const DataBlock& dataBlock, size_t size)
+        {
+            if (!CanHandBack(dataBlock, size, _commitCursor, _reserveCursor))
+            {
+                return std::unexpected(FifoError::InsufficientReserved);
+            }
+
+            AdvanceCommitAndUnreserve(dataBlock, size);
+
+            return {};
+        }
+
+        std::expected<void, FifoError> TryReleaseAndUnpeek(const DataBlock& dataBlock, size_t size)
+        {
+            if (!CanHandBack(dataBlock, size, _readCursor, _peekCursor))
+            {
+                return std::unexpected(FifoError::InsufficientPeeked);
+            }
+
+            AdvanceReleaseAndUnpeek(dataBlock, size);
+
+            return {};
+        }
+
+        void Reset(void)
+        {
+            _reserveCursor = 0;
+            _commitCursor = 0;
+            _peekCursor = 0;
+            _readCursor = 0;
+            _skipEnd = 0;
+            _skipSize = 0;
+        }
+
+        // Touch every page of the buffer so that it is faulted in now rather than on first use.  The contents are
+        // left unchanged.
+        void Prefault(void) requires std::is_trivially_copyable_v<T>
+        {
+            static constexpr size_t pageStride = 4096;
+
+            const auto bytes = std::as_writable_bytes(_ringBufferSpan.first(maxSize));
+            volatile std::byte* data = bytes.data();
+
+            for (size_t offset = 0; offset < bytes.size(); offset += pageStride)
+            {
+                data[offset] = data[offset];
+            }
+        }
+
+#if defined(__unix__) || defined(__APPLE__)
+        // Lock the buffer into physical memory with mlock, which also faults it in.  Returns false if the lock fails,
+        // typically because it would exceed RLIMIT_MEMLOCK.
+        bool LockMemory(void)
+        {
+            return (mlock(_ringBufferSpan.data(), (maxSize * sizeof(T))) == 0);
+        }
+#endif
+
+        // The whole buffer, for registering it with an IO interface.  With mirrored storage this covers both
+        // mappings, so that any block lies inside it.
+        inline std::span<T> Buffer(void) { return _ringBufferSpan; }
+
+        const size_t maxSize;
+        
+    private:
+        // ReadBlock frees everything up to the end of its block, so it cannot be mixed with peeked data that has not
+        // been released.
+        inline bool PeekOutstanding(void) const { return (_peekCursor != _readCursor); }
+
+        // Update the FIFO state for a call whose size has already been checked.  These are shared by the throwing and
+        // Try calls, so that the throwing calls do not pay for building and unpacking a std::expected.
+        //
+        // Each call moves a single cursor.
+        inline DataBlock AdvanceReserve(size_t size)
+        {
+            DataBlock dataBlock = GetDataBlock(_reserveCursor, size);
+            _reserveCursor += size;
+
+            return dataBlock;
+        }
+
+        DataBlock AdvanceReserveContiguous(size_t size)
+        {
+            const size_t tail = (_capacity.Size() - _capacity.Wrap(_reserveCursor));
+
+            if (!Storage::isMirrored && (size > tail))
+            {
+                // Any cursor at the start of the skipped elements moves straight past them.  The previous skip is
+                // always behind the read cursor by now, as the space for this one could not be reserved otherwise.
+                const uint64_t skipStart = _reserveCursor;
+                _skipEnd = (skipStart + tail);
+                _skipSize = tail;
+
+                for (uint64_t* cursor : { &_commitCursor, &_peekCursor, &_readCursor })
+                {
+                    if (*cursor == skipStart)
+                    {
+                        *cursor = _skipEnd;
+                    }
+                }
+
+                _reserveCursor = _skipEnd;
+                _statistics.skips++;
+                _statistics.skippedElements += tail;
+            }
+
+            return AdvanceReserve(size);
+        }
+
+        inline void AdvanceCommit(size_t size)
+        {
+            _commitCursor = Advance(_commitCursor, size);
+        }
+
+        inline void AdvanceUnreserve(size_t size)
+        {
+            _reserveCursor = Retreat(_reserveCursor, size);
+
+            // Drop skipped elements left at the end of the reserved space, so the next reserve can use them.
+            if ((_reserveCursor <= _skipEnd) && (_commitCursor < _skipEnd))
+            {
+                _reserveCursor = std::min(_reserveCursor, (_skipEnd - _skipSize));
+                _skipEnd = 0;
+                _skipSize = 0;
+            }
+        }
+
+        inline void AdvanceCommitAndUnreserve(const DataBlock& dataBlock, size_t size)
+        {
+            AdvanceCommit(size);
+            if (size < dataBlock.size())
+            {
+                AdvanceUnreserve(dataBlock.size() - size);
+            }
+        }
+
+        inline void AdvanceReleaseAndUnpeek(const DataBlock& dataBlock, size_t size)
+        {
+            AdvanceRelease(size);
+            _peekCursor = Retreat(_peekCursor, (dataBlock.size() - size));
+        }
+
+        inline DataBlock AdvanceRead(size_t size)
+        {
+            DataBlock dataBlock = AdvancePeek(size);
+            _readCursor = _peekCursor;
+
+            return dataBlock;
+        }
+
+        inline DataBlock AdvancePeek(size_t size)
+        {
+            DataBlock dataBlock = GetDataBlock(_peekCursor, size);
+            _peekCursor = Advance(_peekCursor, size);
+
+            return dataBlock;
+        }
+
+        inline void AdvanceRelease(size_t size)
+        {
+            _readCursor = Advance(_readCursor, size);
+        }
+
+        // Cursor arithmetic that steps over the elements skipped by ReserveContiguous.  No cursor ever points at or
+        // inside the skipped elements, and only the most recent skip matters - once the read cursor has passed it,
+        // none of these conditions can be true.
+        inline uint64_t Advance(uint64_t cursor, size_t size) const
+        {
+            const uint64_t target = (cursor + size);
+
+            return (((cursor < _skipEnd) && (target >= (_skipEnd - _skipSize))) ? (target + _skipSize) : target);
+        }
+
+        inline uint64_t Retreat(uint64_t cursor, size_t size) const
+        {
+            const uint64_t target = (cursor - size);
+
+            return (((cursor >= _skipEnd) && (target < _skipEnd)) ? (target - _skipSize) : target);
+        }
+
+        inline size_t Distance(uint64_t from, uint64_t to) const
+        {
+            return static_cast<size_t>((to - from) - (((from < _skipEnd) && (_skipEnd <= to)) ? _skipSize : 0));
+        }
+
+        // Number of elements from a cursor that can be returned in the first span of a block, up to the end of the
+        // buffer or the skipped elements.  With mirrored storage, a block is never split.
+        inline size_t ContiguousSize(uint64_t cursor) const
+        {
+            if constexpr (Storage::isMirrored)
+            {
+                return _capacity.Size();
+            }
+
+            return ((_capacity.Size() - _capacity.Wrap(cursor)) - ((cursor < _skipEnd) ? _skipSize : 0));
+        }
+
+        inline size_t ReadUpToSize(size_t size, UpTo upTo) const
+        {
+            return UpToSize(size, upTo, ReadableSize(), ContiguousSize(_peekCursor));
+        }
+
+        // Get a block of data starting at the specified cursor.  This is used by both the Reserve and ReadBlock
+        // functions.  The callers have already checked the size against the FIFO state, so it is never larger than
+        // the FIFO.
+        DataBlock GetDataBlock(uint64_t cursor, size_t size)
+        {
+            if (size == 0)
+            {
+                return DataBlock();
+            }
+
+            const size_t position = _capacity.Wrap(cursor);
+            DataBlock dataBlock;
+
+            // A block that runs into skipped elements continues at the start of the buffer.
+            const size_t remainingBufferSize = ContiguousSize(cursor);
+
+            if constexpr (Storage::isMirrored)
+            {
+                dataBlock = DataBlock(_ringBufferSpan.subspan(position, size));
+            }
+            else if (size > remainingBufferSize)
+            {
+                dataBlock = DataBlock(
+                    _ringBufferSpan.subspan(position, remainingBufferSize),
+                    _ringBufferSpan.subspan(0, (size - remainingBufferSize))
+                    );
+            }
+            else
+            {
+                dataBlock = DataBlock(_ringBufferSpan.subspan(position, size));
+            }
+
+            dataBlock.sequence = cursor;
+
+            return dataBlock;
+        }
+
+        Storage _ringBuffer;
+        CapacityPolicy _capacity;
+        std::span<T> _ringBufferSpan;
+
+        // Free-running element counts.  In stream order, the read cursor trails the peek cursor, which trails the
+        // commit cursor, which trails the reserve cursor, and the reserve cursor is never more than the FIFO size
+        // ahead of the read cursor.
+        uint64_t _reserveCursor = 0;
+        uint64_t _commitCursor = 0;
+        uint64_t _peekCursor = 0;
+        uint64_t _readCursor = 0;
+
+        // Elements at the end of the buffer skipped by the most recent ReserveContiguous, ending at _skipEnd.
+        uint64_t _skipEnd = 0;
+        size_t _skipSize = 0;
+
+        FifoStatistics _statistics;
+    };
+
+    // NoCopyRingFifo with inline storage and a capacity fixed at compile time.
+    template <typename T, size_t Capacity, typename ErrorPolicy = DefaultErrorPolicy>
+    using FixedNoCopyRingFifo = NoCopyRingFifo<T, ArrayStorage<T, Capacity>, FixedCapacity<Capacity>, ErrorPolicy>;
+
+    // Single-producer/single-consumer version of NoCopyRingFifo.
+    // Reserve, Commit, ReservableSize and CommitableSize may only be called from the producer thread, and ReadBlock,
+    // PeekBlock, Release, ReadableSize and ReleasableSize only from the consumer thread.  Reset is not thread safe.
+    //
+    // The cursors are free-running 64-bit element counts, as in NoCopyRingFifo, and a cursor's buffer position is the
+    // cursor modulo the buffer size.  As with NoCopyRingFifo, ReadBlock frees its block immediately, so a consumer
+    // that is still using the data after the call should use PeekBlock and Release instead, and ReadBlock is refused
+    // while peeked data has not been released.
+    template <typename T, typename ErrorPolicy = DefaultErrorPolicy, typename WaitStrategy = YieldWait>
+    class SpscNoCopyRingFifo
+    {
+    public:
+        using DataBlock = FifoTemplates::DataBlock<T>;
+
+        SpscNoCopyRingFifo(size_t size) : maxSize(size)
+        {
+            _ringBuffer.resize(size);
+            _ringBufferSpan = std::span<T>(_ringBuffer);
+        }
+
+        // Reserve a block of FIFO memory, returning a FifoBlock object.
+        // The error policy is raised if there is insufficient reservable space.
+        DataBlock Reserve(size_t size)
+        {
+            if (!HasReservableSpace(size))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientSpace, size, ReservableSize());
+            }
+
+            return AdvanceReserve(size);
+        }
+
+        // Commit a block of data to the FIFO, making it visible to the consumer.
+        // The error policy is raised if there is insufficient reserved space for the commit.
+        void Commit(size_t size)
+        {
+            if (size > CommitableSize())
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientReserved, size, CommitableSize());
+            }
+
+            AdvanceCommit(size);
+        }
+
+        // Blocking versions of Reserve, ReadBlock and PeekBlock, which wait up to the timeout for space or data
+        // instead of failing straight away.  Pass waitForever to wait with no timeout.
+        // The error policy is raised if the call times out, or straight away if the size can never fit in the FIFO.
+        DataBlock Reserve(size_t size, std::chrono::nanoseconds timeout)
+        {
+            if (!WaitForSpace(size, timeout))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientSpace, size, ReservableSize());
+            }
+
+            return AdvanceReserve(size);
+        }
+
+        DataBlock ReadBlock(size_t size, std::chrono::nanoseconds timeout)
+        {
+            if (PeekOutstanding())
+            {
+                ErrorPolicy::Raise(FifoError::PeekOutstanding, size, ReleasableSize());
+            }
+
+            if (!WaitForData(size, timeout))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientData, size, ReadableSize());
+            }
+
+            return AdvanceRead(size);
+        }
+
+        DataBlock PeekBlock(size_t size, std::chrono::nanoseconds timeout)
+        {
+            if (!WaitForData(size, timeout))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientData, size, ReadableSize());
+            }
+
+            return AdvancePeek(size);
+        }
+
+        // Reserve, read or peek as much as is available, up to size elements, see NoCopyRingFifo.  The other side's
+        // cursor is loaded once, so the size cannot change between checking it and taking the block.
+        // The error policy is raised if less than minSize elements are available.
+        DataBlock ReserveUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            const size_t blockSize = ReserveUpToSize(size, upTo);
+            if (blockSize < minSize)
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientSpace, minSize, blockSize);
+            }
+
+            return AdvanceReserve(blockSize);
+        }
+
+        DataBlock ReadUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            if (PeekOutstanding())
+            {
+                ErrorPolicy::Raise(FifoError::PeekOutstanding, size, ReleasableSize());
+            }
+
+            const size_t blockSize = ReadUpToSize(size, upTo);
+            if (blockSize < minSize)
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientData, minSize, blockSize);
+            }
+
+            return AdvanceRead(blockSize);
+        }
+
+        DataBlock PeekUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            const size_t blockSize = ReadUpToSize(size, upTo);
+            if (blockSize < minSize)
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientData, minSize, blockSize);
+            }
+
+            return AdvancePeek(blockSize);
+        }
+
+        // ReservableSize and ReadableSize always load the other side's cursor, and refresh the cached copy of it.
+        inline size_t ReservableSize(void) const
+        {
+            _cachedReadCursor = _readCursor.load(std::memory_order_acquire);
+
+            return (_ringBuffer.size() - (_reserveCursor - _cachedReadCursor));
+        }
+        inline size_t CommitableSize(void) const
+        {
+            return (_reserveCursor - _commitCursor.load(std::memory_order_relaxed));
+        }
+        inline size_t ReadableSize(void) const
+        {
+            _cachedCommitCursor = _commitCursor.load(std::memory_order_acquire);
+
+            return (_cachedCommitCursor - _peekCursor);
+        }
+        inline size_t ReleasableSize(void) const
+        {
+            return (_peekCursor - _readCursor.load(std::memory_order_relaxed));
+        }
+
+        // Get a block of comitted data to read.  The block is freed immediately, so the data must be consumed before
+        // the producer can reserve it again.
+        // The error policy is raised if there is insufficient committed data for the read, or if peeked data has not
+        // been released, as freeing the block would free the peeked data with it.
+        DataBlock ReadBlock(size_t size)
+        {
+            if (PeekOutstanding())
+            {
+                ErrorPolicy::Raise(FifoError::PeekOutstanding, size, ReleasableSize());
+            }
+
+            if (!HasReadableData(size))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientData, size, ReadableSize());
+            }
+
+            return AdvanceRead(size);
+        }
+
+        // Get a block of committed data to read without freeing it.  The producer cannot reserve the block again
+        // until it is handed back with Release.
+        // The error policy is raised if there is insufficient committed data for the peek.
+        DataBlock PeekBlock(size_t size)
+        {
+            if (!HasReadableData(size))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientData, size, ReadableSize());
+            }
+
+            return AdvancePeek(size);
+        }
+
+        // Release a block of peeked data, returning it to the producer.  Blocks are released in the order they were
+        // peeked.
+        // The error policy is raised if there is insufficient peeked data for the release.
+        void Release(size_t size)
+        {
+            if (size > ReleasableSize())
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientPeeked, size, ReleasableSize());
+            }
+
+            AdvanceRelease(size);
+        }
+
+        // Hand back the most recently reserved elements that have not been committed, for example the unused end of
+        // a block reserved for a read of unknown length.  Producer thread only.
+        // The error policy is raised if there is insufficient reserved space.
+        void Unreserve(size_t size)
+        {
+            if (size > CommitableSize())
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientReserved, size, CommitableSize());
+            }
+
+            _reserveCursor -= size;
+        }
+
+        // Hand back the most recently peeked elements that have not been released, so they can be read again.
+        // Consumer thread only.
+        // The error policy is raised if there is insufficient peeked data.
+        void Unpeek(size_t size)
+        {
+            if (size > ReleasableSize())
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientPeeked, size, ReleasableSize());
+            }
+
+            _peekCursor -= size;
+        }
+
+        // Commit the first size elements of a reserved block and hand back the rest, see NoCopyRingFifo.  Producer
+        // thread only.
+        // The error policy is raised if the block is not an outstanding reservation, or is not the oldest or most
+        // recent one when the call needs it to be.
+        void CommitAndUnreserve(const DataBlock& dataBlock, size_t size)
+        {
+            if (!CanHandBack(dataBlock, size, _commitCursor.load(std::memory_order_relaxed), _reserveCursor))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientReserved, dataBlock.size(), CommitableSize());
+            }
+
+            AdvanceCommitAndUnreserve(dataBlock, size);
+        }
+
+        // Release the first size elements of a peeked block and hand back the rest, see NoCopyRingFifo.  Consumer
+        // thread only.
+        // The error policy is raised if the block is not an outstanding peek, or is not the oldest or most recent one
+        // when the call needs it to be.
+        void ReleaseAndUnpeek(const DataBlock& dataBlock, size_t size)
+        {
+            if (!CanHandBack(dataBlock, size, _readCursor.load(std::memory_order_relaxed), _peekCursor))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientPeeked, dataBlock.size(), ReleasableSize());
+            }
+
+            AdvanceReleaseAndUnpeek(dataBlock, size);
+        }
+
+        // Non-throwing versions of the calls above, see NoCopyRingFifo.
+        std::expected<DataBlock, FifoError> TryReserve(size_t size)
+        {
+            if (!HasReservableSpace(size))
+            {
+                return std::unexpected(FifoError::InsufficientSpace);
+            }
+
+            return AdvanceReserve(size);
+        }
+
+        std::expected<void, FifoError> TryCommit(size_t size)
+        {
+            if (size > CommitableSize())
+            {
+                return std::unexpected(FifoError::InsufficientReserved);
+            }
+
+            AdvanceCommit(size);
+
+            return {};
+        }
+
+        std::expected<DataBlock, FifoError> TryReadBlock(size_t size)
+        {
+            if (PeekOutstanding())
+            {
+                return std::unexpected(FifoError::PeekOutstanding);
+            }
+
+            if (!HasReadableData(size))
+            {
+                return std::unexpected(FifoError::InsufficientData);
+            }
+
+            return AdvanceRead(size);
+        }
+
+        std::expected<DataBlock, FifoError> TryPeekBlock(size_t size)
+        {
+            if (!HasReadableData(size))
+            {
+                return std::unexpected(FifoError::InsufficientData);
+            }
+
+            return AdvancePeek(size);
+        }
+
+        std::expected<void, FifoError> TryRelease(size_t size)
+        {
+            if (size > ReleasableSize())
+            {
+                return std::unexpected(FifoError::InsufficientPeeked);
+            }
+
+            AdvanceRelease(size);
+
+            return {};
+        }
+
+        std::expected<DataBlock, FifoError> TryReserve(size_t size, std::chrono::nanoseconds timeout)
+        {
+            if (!WaitForSpace(size, timeout))
+            {
+                return std::unexpected(FifoError::InsufficientSpace);
+            }
+
+            return AdvanceReserve(size);
+        }
+
+        std::expected<DataBlock, FifoError> TryReadBlock(size_t size, std::chrono::nanoseconds timeout)
+        {
+            if (PeekOutstanding())
+            {
+                return std::unexpected(FifoError::PeekOutstanding);
+            }
+
+            if (!WaitForData(size, timeout))
+            {
+                return std::unexpected(FifoError::InsufficientData);
+            }
+
+            return AdvanceRead(size);
+        }
+
+        std::expected<DataBlock, FifoError> TryPeekBlock(size_t size, std::chrono::nanoseconds timeout)
+        {
+            if (!WaitForData(size, timeout))
+            {
+                return std::unexpected(FifoError::InsufficientData);
+            }
+
+            return AdvancePeek(size);
+        }
+
+        std::expected<DataBlock, FifoError> TryReserveUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            const size_t blockSize = ReserveUpToSize(size, upTo);
+            if (blockSize < minSize)
+            {
+                return std::unexpected(FifoError::InsufficientSpace);
+            }
+
+            return AdvanceReserve(blockSize);
+        }
+
+        std::expected<DataBlock, FifoError> TryReadUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            if (PeekOutstanding())
+            {
+                return std::unexpected(FifoError::PeekOutstanding);
+            }
+
+            const size_t blockSize = ReadUpToSize(size, upTo);
+            if (blockSize < minSize)
+            {
+                return std::unexpected(FifoError::InsufficientData);
+            }
+
+            return AdvanceRead(blockSize);
+        }
+
+        std::expected<DataBlock, FifoError> TryPeekUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            const size_t blockSize = ReadUpToSize(size, upTo);
+            if (blockSize < minSize)
+            {
+                return std::unexpected(FifoError::InsufficientData);
+            }
+
+            return AdvancePeek(blockSize);
+        }
+
+        std::expected<void, FifoError> TryCommitAndUnreserve(const DataBlock& dataBlock, size_t size)
+        {
+            if (!CanHandBack(dataBlock, size, _commitCursor.load(std::memory_order_relaxed), _reserveCursor))
+            {
+                return std::unexpected(FifoError::InsufficientReserved);
+            }
+
+            AdvanceCommitAndUnreserve(dataBlock, size);
+
+            return {};
+        }
+
+        std::expected<void, FifoError> TryReleaseAndUnpeek(const DataBlock& dataBlock, size_t size)
+        {
+            if (!CanHandBack(dataBlock, size, _readCursor.load(std::memory_order_relaxed), _peekCursor))
+            {
+                return std::unexpected(FifoError::InsufficientPeeked);
+            }
+
+            AdvanceReleaseAndUnpeek(dataBlock, size);
+
+            return {};
+        }
+
+        void Reset(void)
+        {
+            _reserveCursor = 0;
+            _commitCursor.store(0, std::memory_order_relaxed);
+            _cachedReadCursor = 0;
+            _peekCursor = 0;
+            _readCursor.store(0, std::memory_order_relaxed);
+            _cachedCommitCursor = 0;
+        }
+
+        const size_t maxSize;
+
+    private:
+        // Check for space or data against the cached copy of the other side's cursor, and only load the cursor itself
+        // from the other side's cache line when the cached copy says there is not enough.  The cached copies lag the
+        // real cursors, so they can only under-report what is available.
+        inline bool HasReservableSpace(size_t size) const
+        {
+            return ((size <= (_ringBuffer.size() - (_reserveCursor - _cachedReadCursor))) || (size <= ReservableSize()));
+        }
+
+        inline bool HasReadableData(size_t size) const
+        {
+            return ((size <= (_cachedCommitCursor - _peekCursor)) || (size <= ReadableSize()));
+        }
+
+        // Size of the block for an up-to call.  The other side's cursor is only loaded if the cached copy limits the
+        // block.
+        inline size_t ReserveUpToSize(size_t size, UpTo upTo) const
+        {
+            const size_t contiguous = (_ringBuffer.size() - static_cast<size_t>(_reserveCursor % _ringBuffer.size()));
+            const size_t limit = UpToSize(size, upTo, _ringBuffer.size(), contiguous);
+            const size_t cached = (_ringBuffer.size() - (_reserveCursor - _cachedReadCursor));
+
+            return std::min(limit, ((cached >= limit) ? cached : ReservableSize()));
+        }
+
+        inline size_t ReadUpToSize(size_t size, UpTo upTo) const
+        {
+            const size_t contiguous = (_ringBuffer.size() - static_cast<size_t>(_peekCursor % _ringBuffer.size()));
+            const size_t limit = UpToSize(size, upTo, _ringBuffer.size(), contiguous);
+            const size_t cached = (_cachedCommitCursor - _peekCursor);
+
+            return std::min(limit, ((cached >= limit) ? cached : ReadableSize()));
+        }
+
+        inline bool PeekOutstanding(void) const { return (_peekCursor != _readCursor.load(std::memory_order_relaxed)); }
+
+        // Update the FIFO state for a call whose size has already been checked, see NoCopyRingFifo.
+        inline DataBlock AdvanceReserve(size_t size)
+        {
+            DataBlock dataBlock = GetDataBlock(_reserveCursor, size);
+            _reserveCursor += size;
+
+            return dataBlock;
+        }
+
+        inline void AdvanceCommit(size_t size)
+        {
+            _commitCursor.store(_commitCursor.load(std::memory_order_relaxed) + size, std::memory_order_release);
+            _dataWait.Notify();
+        }
+
+        inline void AdvanceCommitAndUnreserve(const DataBlock& dataBlock, size_t size)
+        {
+            AdvanceCommit(size);
+            _reserveCursor -= (dataBlock.size() - size);
+        }
+
+        inline void AdvanceReleaseAndUnpeek(const DataBlock& dataBlock, size_t size)
+        {
+            AdvanceRelease(size);
+            _peekCursor -= (dataBlock.size() - size);
+        }
+
+        inline DataBlock AdvanceRead(size_t size)
+        {
+            DataBlock dataBlock = AdvancePeek(size);
+            _readCursor.store(_peekCursor, std::memory_order_release);
+            _spaceWait.Notify();
+
+            return dataBlock;
+        }
+
+        inline DataBlock AdvancePeek(size_t size)
+        {
+            DataBlock dataBlock = GetDataBlock(_peekCursor, size);
+            _peekCursor += size;
+
+            return dataBlock;
+        }
+
+        inline void AdvanceRelease(size_t size)
+        {
+            _readCursor.store(_readCursor.load(std::memory_order_relaxed) + size, std::memory_order_release);
+            _spaceWait.Notify();
+        }
+
+        // Wait for space or data for a blocking call.  Returns false on timeout, or if the size is larger than the
+        // FIFO.
+        bool WaitForSpace(size_t size, std::chrono::nanoseconds timeout)
+        {
+            return ((size <= maxSize) &&
+                _spaceWait.Wait([&] { return HasReservableSpace(size); }, WaitDeadline(timeout)));
+        }
+
+        bool WaitForData(size_t size, std::chrono::nanoseconds timeout)
+        {
+            return ((size <= maxSize) &&
+                _dataWait.Wait([&] { return HasReadableData(size); }, WaitDeadline(timeout)));
+        }
+
+        // Get a block of data starting at the specified cursor.
+        DataBlock GetDataBlock(uint64_t cursor, size_t size)
+        {
+            if (size == 0)
+            {
+                return DataBlock();
+            }
+
+            const size_t position = static_cast<size_t>(cursor % _ringBuffer.size());
+            const size_t remainingBufferSize = (_ringBuffer.size() - position);
+            DataBlock dataBlock;
+
+            if (size > remainingBufferSize)
+            {
+                dataBlock = DataBlock(
+                    _ringBufferSpan.subspan(position, remainingBufferSize),
+                    _ringBufferSpan.subspan(0, (size - remainingBufferSize))
+                    );
+            }
+            else
+            {
+                dataBlock = DataBlock(_ringBufferSpan.subspan(position, size));
+            }
+
+            dataBlock.sequence = cursor;
+
+            return dataBlock;
+        }
+
+        std::vector<T> _ringBuffer;
+        std::span<T> _ringBufferSpan;
+
+        // Producer-owned state, with the producer's copy of the read cursor.  The consumer only reads this line to
+        // refresh its copy of the commit cursor.
+        alignas(cacheLineSize) uint64_t _reserveCursor = 0;
+        std::atomic<uint64_t> _commitCursor = 0;
+        mutable uint64_t _cachedReadCursor = 0;
+
+        // Consumer-owned state, with the consumer's copy of the commit cursor.
+        alignas(cacheLineSize) uint64_t _peekCursor = 0;
+        std::atomic<uint64_t> _readCursor = 0;
+        mutable uint64_t _cachedCommitCursor = 0;
+
+        // The consumer waits for data on one wait strategy object and the producer for space on the other.
+        alignas(cacheLineSize) WaitStrategy _dataWait;
+        WaitStrategy _spaceWait;
     };
 }
\ No newline at end of file
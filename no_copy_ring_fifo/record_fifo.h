@@ -0,0 +1,212 @@
+/*
+*   RecordFifo class
+*
+*   Variable-length records over a FIFO of single-byte elements, with the record boundaries kept in the ring itself.
+*   Each record is an 8-byte length header followed by the payload, padded so the next header starts on an 8-byte
+*   boundary.  The FIFO capacity must be a multiple of 8, so a header never wraps around the end of the buffer,
+*   although a payload may still be split between the two spans of its DataBlock.
+*
+*   ReserveRecord writes the header and returns the payload block, and CommitRecord publishes the header and payload
+*   together with one Commit, so the reader never sees a header without its payload.  ReadRecord and PeekRecord look
+*   at the header of the next record and take the whole record or nothing.  The calls map onto Reserve, Commit,
+*   ReadBlock, PeekBlock and Release, so RecordFifo works over NoCopyRingFifo, SpscNoCopyRingFifo (from the producer
+*   and consumer threads) and SharedMemoryNoCopyRingFifo.  Every block in the FIFO must be a record.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <format>
+#include <stdexcept>
+
+#include "no_copy_ring_fifo.h"
+
+namespace FifoTemplates
+{
+    template <typename Fifo> class RecordFifo
+    {
+        static_assert(sizeof(typename Fifo::DataBlock::element_type) == 1, "RecordFifo needs a FIFO of single-byte elements");
+
+    public:
+        using DataBlock = typename Fifo::DataBlock;
+
+        // Size of the length header, which is also the record alignment.
+        static constexpr size_t headerSize = sizeof(uint64_t);
+
+        // Throws std::invalid_argument if the FIFO capacity is not a multiple of the record alignment.
+        RecordFifo(Fifo& fifo) : _fifo(fifo)
+        {
+            if ((fifo.maxSize % headerSize) != 0)
+            {
+                throw std::invalid_argument(
+                    std::format("Record FIFO size must be a multiple of {} - size {}", headerSize, fifo.maxSize)
+                    );
+            }
+        }
+
+        // Space a record of the given payload size takes in the FIFO, including the header and padding.  The size
+        // must fit in the FIFO, see MaxRecordSize, or the rounding can overflow.
+        static constexpr size_t RecordSpace(size_t size)
+        {
+            return (headerSize + (((size + headerSize - 1) / headerSize) * headerSize));
+        }
+
+        // Largest payload a record in this FIFO can carry.
+        inline size_t MaxRecordSize(void) const { return (_fifo.maxSize - headerSize); }
+
+        // Reserve a record and write its header, returning the payload block.  The record is not visible to the
+        // reader until CommitRecord.  Records are committed in the order they were reserved.
+        // The FIFO's error policy is raised if there is insufficient space for the record.
+        DataBlock ReserveRecord(size_t size)
+        {
+            return WriteHeader(_fifo.Reserve(Space(size)), size);
+        }
+
+        std::expected<DataBlock, FifoError> TryReserveRecord(size_t size)
+        {
+            auto dataBlock = _fifo.TryReserve(Space(size));
+            if (!dataBlock.has_value())
+            {
+                return std::unexpected(dataBlock.error());
+            }
+
+            return WriteHeader(*dataBlock, size);
+        }
+
+        // Publish a record returned by ReserveRecord.
+        void CommitRecord(const DataBlock& record)
+        {
+            _fifo.Commit(RecordSpace(record.size()));
+        }
+
+        // Take the next whole record, returning its payload block.  The record is freed immediately, as with
+        // ReadBlock.
+        // The FIFO's error policy is raised if there is no committed record.
+        DataBlock ReadRecord(void)
+        {
+            const size_t size = LengthFromHeader(_fifo.PeekBlock(headerSize));
+            _fifo.Unpeek(headerSize);
+
+            return Payload(_fifo.ReadBlock(Space(size)), size);
+        }
+
+        std::expected<DataBlock, FifoError> TryReadRecord(void)
+        {
+            const auto size = NextRecordSize();
+            if (!size.has_value())
+            {
+                return std::unexpected(size.error());
+            }
+
+            auto dataBlock = _fifo.TryReadBlock(Space(*size));
+            if (!dataBlock.has_value())
+            {
+                return std::unexpected(dataBlock.error());
+            }
+
+            return Payload(*dataBlock, *size);
+        }
+
+        // Take the next whole record without freeing it, returning its payload block.  Records are handed back with
+        // ReleaseRecord in the order they were peeked.
+        // The FIFO's error policy is raised if there is no committed record.
+        DataBlock PeekRecord(void)
+        {
+            const size_t size = LengthFromHeader(_fifo.PeekBlock(headerSize));
+            _fifo.Unpeek(headerSize);
+
+            return Payload(_fifo.PeekBlock(Space(size)), size);
+        }
+
+        std::expected<DataBlock, FifoError> TryPeekRecord(void)
+        {
+            const auto size = NextRecordSize();
+            if (!size.has_value())
+            {
+                return std::unexpected(size.error());
+            }
+
+            auto dataBlock = _fifo.TryPeekBlock(Space(*size));
+            if (!dataBlock.has_value())
+            {
+                return std::unexpected(dataBlock.error());
+            }
+
+            return Payload(*dataBlock, *size);
+        }
+
+        // Release a record returned by PeekRecord.
+        void ReleaseRecord(const DataBlock& record)
+        {
+            _fifo.Release(RecordSpace(record.size()));
+        }
+
+    private:
+        // Space for a record, checking the size before rounding it.  A size too large for any record becomes one
+        // more than the FIFO holds, so the FIFO's own size check raises or fails the call.
+        inline size_t Space(size_t size) const
+        {
+            return ((size > MaxRecordSize()) ? (_fifo.maxSize + 1) : RecordSpace(size));
+        }
+
+        // Read the length from the header of the next committed record without taking it.
+        std::expected<size_t, FifoError> NextRecordSize(void)
+        {
+            auto header = _fifo.TryPeekBlock(headerSize);
+            if (!header.has_value())
+            {
+                return std::unexpected(header.error());
+            }
+
+            _fifo.Unpeek(headerSize);
+
+            return LengthFromHeader(*header);
+        }
+
+        static size_t LengthFromHeader(const DataBlock& header)
+        {
+            uint64_t size = 0;
+            std::memcpy(&size, header.spans[0].data(), headerSize);
+
+            return static_cast<size_t>(size);
+        }
+
+        DataBlock WriteHeader(const DataBlock& dataBlock, size_t size)
+        {
+            const uint64_t header = size;
+            std::memcpy(dataBlock.spans[0].data(), &header, headerSize);
+
+            return Payload(dataBlock, size);
+        }
+
+        // The payload part of a whole record block.  The header is always in the first span.
+        static DataBlock Payload(const DataBlock& dataBlock, size_t size)
+        {
+            auto first = dataBlock.spans[0].subspan(headerSize);
+            auto second = dataBlock.spans[1];
+
+            DataBlock payload;
+            if (first.empty())
+            {
+                payload = DataBlock(second.first(size));
+            }
+            else if (size <= first.size())
+            {
+                payload = DataBlock(first.first(size));
+            }
+            else
+            {
+                payload = DataBlock(std::move(first), second.first(size - first.size()));
+            }
+
+            payload.sequence = (dataBlock.sequence + headerSize);
+
+            return payload;
+        }
+
+        Fifo& _fifo;
+    };
+}
@@ -0,0 +1,1029 @@
+/*
+*   SharedMemoryNoCopyRingFifo class
+*
+*   Single-producer/single-consumer NoCopyRingFifo for two processes.  The FIFO lives in one shared memory mapping,
+*   a header holding the shared cursors followed by the data region, so one process reserves and commits blocks and
+*   the other reads them in place with no copies.
+*
+*   Nothing in the mapping is a pointer.  The header records the data region as an offset from the start of the
+*   mapping, and each process builds its own spans from wherever the mapping landed in its address space.  The
+*   process-local reserve and peek cursors and the cached copies of the other side's cursor stay in the
+*   SharedMemoryNoCopyRingFifo object, as in SpscNoCopyRingFifo, and as there ReadBlock is refused while peeked data
+*   has not been released.
+*
+*   Create makes a new FIFO, either under a POSIX shared memory name (shm_open) or in an anonymous memfd whose
+*   descriptor can be inherited or passed over a Unix socket.  Attach maps an existing FIFO and checks the header
+*   magic, layout version, element size and capacity before using it, throwing std::runtime_error on a mismatch.
+*   The creator writes the magic last, so attaching to a FIFO that is still being created fails rather than reading
+*   a half-written header.  Named FIFOs stay in /dev/shm until Unlink is called.
+*
+*   Both processes must be built with the same element type and cache line size, which the header also checks.  Only
+*   the non-blocking calls are provided, as the wait strategies park on process-private futexes.
+*
+*   Each side can take a lease with AcquireProducer or AcquireConsumer, which is a robust process-shared mutex held
+*   for as long as the side is in use.  The holder also records its process and thread IDs and the thread's start time
+*   in the header, so the other side can check it is still running with ProducerAlive or ConsumerAlive without
+*   touching the mutex, and a thread that reuses the IDs after the holder exits is not mistaken for it.  If the holder
+*   dies the kernel marks the mutex, and a replacement process can take the lease over and carry on from the shared
+*   cursors without reinitialising the FIFO:
+*
+*   - Blocks a dead producer reserved but never committed are dropped, as only committed data moves the shared
+*     commit cursor.  The new producer reserves again from the commit cursor.
+*   - Blocks a dead consumer peeked but never released are delivered again, starting from the shared read cursor.
+*
+*   A lease belongs to the thread that acquired it, and must be released from that thread, either explicitly or by
+*   destroying the FIFO object.  Releasing it from another thread fails, and a FIFO object destroyed on another thread
+*   leaves the lease held until the acquiring thread exits.  A thread that exits while holding a lease counts as dead.
+*   The liveness check reads the holder's start time from /proc, so it relies on both processes sharing a PID
+*   namespace and seeing each other's /proc entries.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <format>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "no_copy_ring_fifo.h"
+
+namespace FifoTemplates
+{
+    // Identity of the thread holding a shared FIFO lease.  Thread IDs are reused once a thread exits, so the start time
+    // of the thread is recorded with them.
+    struct SharedLeaseOwner
+    {
+        std::atomic<uint64_t> id;           // (process ID << 32) | thread ID, or zero while the lease is free.
+        std::atomic<uint64_t> startTime;    // Start time of the thread in clock ticks since boot.
+    };
+
+    // Layout of the start of a shared FIFO mapping.  The data region follows at dataOffset.
+    struct SharedFifoHeader
+    {
+        static constexpr uint64_t expectedMagic = 0x4F4649465243434EULL; // "NCCRFIFO"
+        static constexpr uint32_t expectedVersion = 4;
+
+        std::atomic<uint64_t> magic;
+        uint32_t version;
+        uint32_t headerSize;
+        uint64_t elementSize;
+        uint64_t capacity;
+        uint64_t dataOffset;
+
+        // Written by the producer process.
+        alignas(cacheLineSize) std::atomic<uint64_t> commitCursor;
+
+        // Written by the consumer process.
+        alignas(cacheLineSize) std::atomic<uint64_t> readCursor;
+
+        // Robust mutexes held by the live producer and consumer, see AcquireProducer.
+        alignas(cacheLineSize) pthread_mutex_t producerLease;
+        pthread_mutex_t consumerLease;
+
+        // Lease holders, see SharedLeaseOwner.
+        SharedLeaseOwner producerOwner;
+        SharedLeaseOwner consumerOwner;
+    };
+
+    // Result of taking a shared FIFO lease.
+    enum class LeaseStatus
+    {
+        Acquired,           // The lease was free.
+        Recovered,          // The previous holder died, and the caller has taken over from the shared cursors.
+        HeldByLiveOwner     // Another live thread holds the lease.
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared FIFO cursors must be lock free");
+
+    template <typename T, typename ErrorPolicy = DefaultErrorPolicy> class SharedMemoryNoCopyRingFifo
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "Shared FIFO elements must be trivially copyable");
+
+    public:
+        using DataBlock = FifoTemplates::DataBlock<T>;
+
+        // Create a FIFO under a POSIX shared memory name, failing if the name already exists.
+        static SharedMemoryNoCopyRingFifo Create(const std::string& name, size_t size)
+        {
+            const int fd = shm_open(name.c_str(), (O_CREAT | O_EXCL | O_RDWR), (S_IRUSR | S_IWUSR));
+            if (fd < 0)
+            {
+                throw std::system_error(errno, std::system_category(), std::format("shm_open of {} failed", name));
+            }
+
+            return SharedMemoryNoCopyRingFifo(fd, size);
+        }
+
+        // Create a FIFO in an anonymous memfd.  Fd() returns the descriptor to hand to the other process.
+        static SharedMemoryNoCopyRingFifo Create(size_t size)
+        {
+            const int fd = memfd_create("SharedMemoryNoCopyRingFifo", 0);
+            if (fd < 0)
+            {
+                throw std::system_error(errno, std::system_category(), "memfd_create failed");
+            }
+
+            return SharedMemoryNoCopyRingFifo(fd, size);
+        }
+
+        // Attach to a FIFO created under a POSIX shared memory name.
+        static SharedMemoryNoCopyRingFifo Attach(const std::string& name)
+        {
+            const int fd = shm_open(name.c_str(), O_RDWR, 0);
+            if (fd < 0)
+            {
+                throw std::system_error(errno, std::system_category(), std::format("shm_open of {} failed", name));
+            }
+
+            return SharedMemoryNoCopyRingFifo(fd, MapExisting(fd));
+        }
+
+        // Attach to a FIFO through a descriptor for its memory.  The FIFO takes its own copy of the descriptor.
+        static SharedMemoryNoCopyRingFifo Attach(int fd)
+        {
+            const int ownFd = dup(fd);
+            if (ownFd < 0)
+            {
+                throw std::system_error(errno, std::system_category(), "dup failed");
+            }
+
+            return SharedMemoryNoCopyRingFifo(ownFd, MapExisting(ownFd));
+        }
+
+        // Remove a FIFO name.  Processes that have the FIFO mapped keep using it.
+        static void Unlink(const std::string& name)
+        {
+            shm_unlink(name.c_str());
+        }
+
+        SharedMemoryNoCopyRingFifo(SharedMemoryNoCopyRingFifo&& other) noexcept :
+            maxSize(other.maxSize),
+            _fd(std::exchange(other._fd, -1)),
+            _mapping(std::exchange(other._mapping, nullptr)),
+            _mappingSize(other._mappingSize),
+            _header(other._header),
+            _ringBufferSpan(other._ringBufferSpan),
+            _reserveCursor(other._reserveCursor),
+            _cachedReadCursor(other._cachedReadCursor),
+            _peekCursor(other._peekCursor),
+            _cachedCommitCursor(other._cachedCommitCursor),
+            _producerLeaseHeld(std::exchange(other._producerLeaseHeld, false)),
+            _consumerLeaseHeld(std::exchange(other._consumerLeaseHeld, false))
+        {
+        }
+
+        SharedMemoryNoCopyRingFifo(const SharedMemoryNoCopyRingFifo&) = delete;
+        SharedMemoryNoCopyRingFifo& operator=(const SharedMemoryNoCopyRingFifo&) = delete;
+
+        ~SharedMemoryNoCopyRingFifo()
+        {
+            // A lease taken on another thread cannot be released here, and is left to the kernel to mark when that
+            // thread exits.
+            if (_producerLeaseHeld)
+            {
+                (void)ReleaseLease(_header->producerLease, _header->producerOwner);
+            }
+
+            if (_consumerLeaseHeld)
+            {
+                (void)ReleaseLease(_header->consumerLease, _header->consumerOwner);
+            }
+
+            if (_mapping != nullptr)
+            {
+                munmap(_mapping, _mappingSize);
+            }
+
+            if (_fd >= 0)
+            {
+                close(_fd);
+            }
+        }
+
+        // Reserve a block of FIFO memory, returning a FifoBlock object.  Producer process only.
+        // The error policy is raised if there is insufficient reservable space.
+        DataBlock Reserve(size_t size)
+        {
+            if (!HasReservableSpace(size))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientSpace, size, ReservableSize());
+            }
+
+            return AdvanceReserve(size);
+        }
+
+        // Commit a block of data to the FIFO, making it visible to the consumer process.  Producer process only.
+        // The error policy is raised if there is insufficient reserved space for the commit.
+        void Commit(size_t size)
+        {
+            if (size > CommitableSize())
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientReserved, size, CommitableSize());
+            }
+
+            AdvanceCommit(size);
+        }
+
+        // Get a block of comitted data to read, freeing it immediately.  Consumer process only.
+        // The error policy is raised if there is insufficient committed data for the read, or if peeked data has not
+        // been released, as freeing the block would free the peeked data with it.
+        DataBlock ReadBlock(size_t size)
+        {
+            if (PeekOutstanding())
+            {
+                ErrorPolicy::Raise(FifoError::PeekOutstanding, size, ReleasableSize());
+            }
+
+            if (!HasReadableData(size))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientData, size, ReadableSize());
+            }
+
+            return AdvanceRead(size);
+        }
+
+        // Get a block of committed data to read without freeing it.  Consumer process only.
+        // The error policy is raised if there is insufficient committed data for the peek.
+        DataBlock PeekBlock(size_t size)
+        {
+            if (!HasReadableData(size))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientData, size, ReadableSize());
+            }
+
+            return AdvancePeek(size);
+        }
+
+        // Release a block of peeked data, returning it to the producer.  Consumer process only.
+        // The error policy is raised if there is insufficient peeked data for the release.
+        void Release(size_t size)
+        {
+            if (size > ReleasableSize())
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientPeeked, size, ReleasableSize());
+            }
+
+            AdvanceRelease(size);
+        }
+
+        // Hand back the most recently reserved elements that have not been committed, for example the unused end of
+        // a block reserved for a read of unknown length.  Producer process only.
+        // The error policy is raised if there is insufficient reserved space.
+        void Unreserve(size_t size)
+        {
+            if (size > CommitableSize())
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientReserved, size, CommitableSize());
+            }
+
+            _reserveCursor -= size;
+        }
+
+        // Hand back the most recently peeked elements that have not been released, so they can be read again.
+        // Consumer process only.
+        // The error policy is raised if there is insufficient peeked data.
+        void Unpeek(size_t size)
+        {
+            if (size > ReleasableSize())
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientPeeked, size, ReleasableSize());
+            }
+
+            _peekCursor -= size;
+        }
+
+        // Commit the first size elements of a reserved block and hand back the rest, see NoCopyRingFifo.  Producer
+        // process only.
+        // The error policy is raised if the block is not an outstanding reservation, or is not the oldest or most
+        // recent one when the call needs it to be.
+        void CommitAndUnreserve(const DataBlock& dataBlock, size_t size)
+        {
+            if (!CanHandBack(dataBlock, size, _header->commitCursor.load(std::memory_order_relaxed), _reserveCursor))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientReserved, dataBlock.size(), CommitableSize());
+            }
+
+            AdvanceCommitAndUnreserve(dataBlock, size);
+        }
+
+        // Release the first size elements of a peeked block and hand back the rest, see NoCopyRingFifo.  Consumer
+        // process only.
+        // The error policy is raised if the block is not an outstanding peek, or is not the oldest or most recent one
+        // when the call needs it to be.
+        void ReleaseAndUnpeek(const DataBlock& dataBlock, size_t size)
+        {
+            if (!CanHandBack(dataBlock, size, _header->readCursor.load(std::memory_order_relaxed), _peekCursor))
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientPeeked, dataBlock.size(), ReleasableSize());
+            }
+
+            AdvanceReleaseAndUnpeek(dataBlock, size);
+        }
+
+        // Reserve, read or peek as much as is available, up to size elements, see NoCopyRingFifo.  Producer process
+        // for ReserveUpTo, consumer process for ReadUpTo and PeekUpTo.
+        // The error policy is raised if less than minSize elements are available.
+        DataBlock ReserveUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            const size_t blockSize = ReserveUpToSize(size, upTo);
+            if (blockSize < minSize)
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientSpace, minSize, blockSize);
+            }
+
+            return AdvanceReserve(blockSize);
+        }
+
+        DataBlock ReadUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            if (PeekOutstanding())
+            {
+                ErrorPolicy::Raise(FifoError::PeekOutstanding, size, ReleasableSize());
+            }
+
+            const size_t blockSize = ReadUpToSize(size, upTo);
+            if (blockSize < minSize)
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientData, minSize, blockSize);
+            }
+
+            return AdvanceRead(blockSize);
+        }
+
+        DataBlock PeekUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            const size_t blockSize = ReadUpToSize(size, upTo);
+            if (blockSize < minSize)
+            {
+                ErrorPolicy::Raise(FifoError::InsufficientData, minSize, blockSize);
+            }
+
+            return AdvancePeek(blockSize);
+        }
+
+        // Non-throwing versions of the calls above, see NoCopyRingFifo.
+        std::expected<DataBlock, FifoError> TryReserve(size_t size)
+        {
+            if (!HasReservableSpace(size))
+            {
+                return std::unexpected(FifoError::InsufficientSpace);
+            }
+
+            return AdvanceReserve(size);
+        }
+
+        std::expected<void, FifoError> TryCommit(size_t size)
+        {
+            if (size > CommitableSize())
+            {
+                return std::unexpected(FifoError::InsufficientReserved);
+            }
+
+            AdvanceCommit(size);
+
+            return {};
+        }
+
+        std::expected<DataBlock, FifoError> TryReadBlock(size_t size)
+        {
+            if (PeekOutstanding())
+            {
+                return std::unexpected(FifoError::PeekOutstanding);
+            }
+
+            if (!HasReadableData(size))
+            {
+                return std::unexpected(FifoError::InsufficientData);
+            }
+
+            return AdvanceRead(size);
+        }
+
+        std::expected<DataBlock, FifoError> TryPeekBlock(size_t size)
+        {
+            if (!HasReadableData(size))
+            {
+                return std::unexpected(FifoError::InsufficientData);
+            }
+
+            return AdvancePeek(size);
+        }
+
+        std::expected<void, FifoError> TryRelease(size_t size)
+        {
+            if (size > ReleasableSize())
+            {
+                return std::unexpected(FifoError::InsufficientPeeked);
+            }
+
+            AdvanceRelease(size);
+
+            return {};
+        }
+
+        std::expected<DataBlock, FifoError> TryReserveUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            const size_t blockSize = ReserveUpToSize(size, upTo);
+            if (blockSize < minSize)
+            {
+                return std::unexpected(FifoError::InsufficientSpace);
+            }
+
+            return AdvanceReserve(blockSize);
+        }
+
+        std::expected<DataBlock, FifoError> TryReadUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            if (PeekOutstanding())
+            {
+                return std::unexpected(FifoError::PeekOutstanding);
+            }
+
+            const size_t blockSize = ReadUpToSize(size, upTo);
+            if (blockSize < minSize)
+            {
+                return std::unexpected(FifoError::InsufficientData);
+            }
+
+            return AdvanceRead(blockSize);
+        }
+
+        std::expected<DataBlock, FifoError> TryPeekUpTo(size_t size, size_t minSize = 0, UpTo upTo = UpTo::Available)
+        {
+            const size_t blockSize = ReadUpToSize(size, upTo);
+            if (blockSize < minSize)
+            {
+                return std::unexpected(FifoError::InsufficientData);
+            }
+
+            return AdvancePeek(blockSize);
+        }
+
+        std::expected<void, FifoError> TryCommitAndUnreserve(const DataBlock& dataBlock, size_t size)
+        {
+            if (!CanHandBack(dataBlock, size, _header->commitCursor.load(std::memory_order_relaxed), _reserveCursor))
+            {
+                return std::unexpected(FifoError::InsufficientReserved);
+            }
+
+            AdvanceCommitAndUnreserve(dataBlock, size);
+
+            return {};
+        }
+
+        std::expected<void, FifoError> TryReleaseAndUnpeek(const DataBlock& dataBlock, size_t size)
+        {
+            if (!CanHandBack(dataBlock, size, _header->readCursor.load(std::memory_order_relaxed), _peekCursor))
+            {
+                return std::unexpected(FifoError::InsufficientPeeked);
+            }
+
+            AdvanceReleaseAndUnpeek(dataBlock, size);
+
+            return {};
+        }
+
+        // ReservableSize and CommitableSize are for the producer process, ReadableSize and ReleasableSize for the
+        // consumer process.
+        inline size_t ReservableSize(void) const
+        {
+            _cachedReadCursor = _header->readCursor.load(std::memory_order_acquire);
+
+            return (maxSize - (_reserveCursor - _cachedReadCursor));
+        }
+        inline size_t CommitableSize(void) const
+        {
+            return (_reserveCursor - _header->commitCursor.load(std::memory_order_relaxed));
+        }
+        inline size_t ReadableSize(void) const
+        {
+            _cachedCommitCursor = _header->commitCursor.load(std::memory_order_acquire);
+
+            return (_cachedCommitCursor - _peekCursor);
+        }
+        inline size_t ReleasableSize(void) const
+        {
+            return (_peekCursor - _header->readCursor.load(std::memory_order_relaxed));
+        }
+
+        // Take the producer lease.  On success the reserve cursor restarts from the shared commit cursor, which
+        // discards anything reserved but not committed through this object or by a dead producer.
+        LeaseStatus AcquireProducer(void)
+        {
+            const LeaseStatus status = AcquireLease(_header->producerLease, _header->producerOwner);
+            if (status != LeaseStatus::HeldByLiveOwner)
+            {
+                _producerLeaseHeld = true;
+                _reserveCursor = _header->commitCursor.load(std::memory_order_acquire);
+                _cachedReadCursor = _header->readCursor.load(std::memory_order_acquire);
+            }
+
+            return status;
+        }
+
+        // Take the consumer lease.  On success the peek cursor restarts from the shared read cursor, so blocks that
+        // were peeked but not released are read again.
+        LeaseStatus AcquireConsumer(void)
+        {
+            const LeaseStatus status = AcquireLease(_header->consumerLease, _header->consumerOwner);
+            if (status != LeaseStatus::HeldByLiveOwner)
+            {
+                _consumerLeaseHeld = true;
+                _peekCursor = _header->readCursor.load(std::memory_order_acquire);
+                _cachedCommitCursor = _header->commitCursor.load(std::memory_order_acquire);
+            }
+
+            return status;
+        }
+
+        // Give up a lease taken by the calling thread.  Throws std::system_error with EPERM, leaving the lease held, if
+        // the calling thread is not the holder.
+        void ReleaseProducer(void)
+        {
+            const int result = ReleaseLease(_header->producerLease, _header->producerOwner);
+            if (result != 0)
+            {
+                throw std::system_error(result, std::system_category(), "Producer lease release failed");
+            }
+
+            _producerLeaseHeld = false;
+        }
+
+        void ReleaseConsumer(void)
+        {
+            const int result = ReleaseLease(_header->consumerLease, _header->consumerOwner);
+            if (result != 0)
+            {
+                throw std::system_error(result, std::system_category(), "Consumer lease release failed");
+            }
+
+            _consumerLeaseHeld = false;
+        }
+
+        // Check whether a live thread holds the other side's lease.  Returns true when called by the holder.  The
+        // mutex is not touched, so the check cannot get in the way of an AcquireProducer or AcquireConsumer, or take
+        // a dead holder's lease over in place of its replacement.
+        bool ProducerAlive(void) const { return LeaseHeld(_header->producerOwner); }
+        bool ConsumerAlive(void) const { return LeaseHeld(_header->consumerOwner); }
+
+        // Descriptor for the FIFO memory, for passing to the process that attaches to it.
+        inline int Fd(void) const { return _fd; }
+
+        const size_t maxSize;
+
+    private:
+        // Create a FIFO in the memory behind a new descriptor.
+        SharedMemoryNoCopyRingFifo(int fd, size_t size) : maxSize(size), _fd(fd)
+        {
+            if (size == 0)
+            {
+                close(_fd);
+                throw std::invalid_argument("Shared FIFO size must be greater than zero");
+            }
+
+            _mappingSize = (DataOffset() + (size * sizeof(T)));
+
+            if (ftruncate(_fd, static_cast<off_t>(_mappingSize)) != 0)
+            {
+                const int error = errno;
+                close(_fd);
+                throw std::system_error(error, std::system_category(), "ftruncate failed");
+            }
+
+            Map();
+
+            _header = new (_mapping) SharedFifoHeader{};
+            _header->version = SharedFifoHeader::expectedVersion;
+            _header->headerSize = sizeof(SharedFifoHeader);
+            _header->elementSize = sizeof(T);
+            _header->capacity = size;
+            _header->dataOffset = DataOffset();
+            _header->commitCursor.store(0, std::memory_order_relaxed);
+            _header->readCursor.store(0, std::memory_order_relaxed);
+
+            try
+            {
+                InitLease(_header->producerLease);
+                InitLease(_header->consumerLease);
+            }
+            catch (...)
+            {
+                munmap(_mapping, _mappingSize);
+                close(_fd);
+                throw;
+            }
+
+            _header->magic.store(SharedFifoHeader::expectedMagic, std::memory_order_release);
+
+            SetSpan();
+        }
+
+        struct Mapping
+        {
+            void* address;
+            size_t size;
+        };
+
+        // Attach to a FIFO mapped and checked by MapExisting.
+        SharedMemoryNoCopyRingFifo(int fd, Mapping mapping) :
+            maxSize(static_cast<SharedFifoHeader*>(mapping.address)->capacity),
+            _fd(fd),
+            _mapping(mapping.address),
+            _mappingSize(mapping.size)
+        {
+            _header = static_cast<SharedFifoHeader*>(_mapping);
+            SetSpan();
+
+            // Pick up the stream where the other process has got to.
+            _reserveCursor = _header->commitCursor.load(std::memory_order_acquire);
+            _peekCursor = _header->readCursor.load(std::memory_order_acquire);
+            _cachedReadCursor = _peekCursor;
+            _cachedCommitCursor = _reserveCursor;
+        }
+
+        // Map the memory behind a descriptor and check that it holds a compatible FIFO.  Closes the descriptor and
+        // throws if it does not.  The magic is loaded with acquire, pairing with the creator's release store, so the
+        // rest of the header is complete once the magic matches.
+        static Mapping MapExisting(int fd)
+        {
+            struct stat status;
+            if (fstat(fd, &status) != 0)
+            {
+                const int error = errno;
+                close(fd);
+                throw std::system_error(error, std::system_category(), "fstat failed");
+            }
+
+            const size_t mappingSize = static_cast<size_t>(status.st_size);
+            if (mappingSize < DataOffset())
+            {
+                close(fd);
+                throw std::runtime_error(
+                    std::format("Cannot attach to shared FIFO - {} bytes is too small for a FIFO header", mappingSize)
+                    );
+            }
+
+            void* address = mmap(nullptr, mappingSize, (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0);
+            if (address == MAP_FAILED)
+            {
+                const int error = errno;
+                close(fd);
+                throw std::system_error(error, std::system_category(), "mmap failed");
+            }
+
+            const SharedFifoHeader* header = static_cast<const SharedFifoHeader*>(address);
+
+            std::string error;
+            if (header->magic.load(std::memory_order_acquire) != SharedFifoHeader::expectedMagic)
+            {
+                error = "bad magic, or not fully created";
+            }
+            else if ((header->version != SharedFifoHeader::expectedVersion) ||
+                (header->headerSize != sizeof(SharedFifoHeader)))
+            {
+                error = std::format("layout version {} and header size {} do not match {} and {}",
+                    header->version,
+                    header->headerSize,
+                    SharedFifoHeader::expectedVersion,
+                    sizeof(SharedFifoHeader));
+            }
+            else if (header->elementSize != sizeof(T))
+            {
+                error = std::format("element size {} does not match {}", header->elementSize, sizeof(T));
+            }
+            else if ((header->capacity == 0) || (header->dataOffset != DataOffset()) ||
+                (((mappingSize - DataOffset()) / sizeof(T)) < header->capacity))
+            {
+                error = std::format("capacity {} and data offset {} do not fit in {} bytes",
+                    header->capacity,
+                    header->dataOffset,
+                    mappingSize);
+            }
+
+            if (!error.empty())
+            {
+                munmap(address, mappingSize);
+                close(fd);
+                throw std::runtime_error(std::format("Cannot attach to shared FIFO - {}", error));
+            }
+
+            return Mapping{ address, mappingSize };
+        }
+
+        // Initialise a lease as a robust process-shared mutex.  Throws std::system_error if the system cannot provide
+        // one, as a lease that is not robust would never be recovered from a dead holder.
+        static void InitLease(pthread_mutex_t& lease)
+        {
+            pthread_mutexattr_t attributes;
+            int result = pthread_mutexattr_init(&attributes);
+            if (result != 0)
+            {
+                throw std::system_error(result, std::system_category(), "pthread_mutexattr_init failed");
+            }
+
+            result = pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+            if (result == 0)
+            {
+                result = pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+            }
+
+            if (result == 0)
+            {
+                result = pthread_mutex_init(&lease, &attributes);
+            }
+
+            pthread_mutexattr_destroy(&attributes);
+
+            if (result != 0)
+            {
+                throw std::system_error(result, std::system_category(), "Robust shared mutex initialisation failed");
+            }
+        }
+
+        static LeaseStatus AcquireLease(pthread_mutex_t& lease, SharedLeaseOwner& owner)
+        {
+            const int result = pthread_mutex_trylock(&lease);
+
+            if (result == 0)
+            {
+                RecordOwner(owner);
+
+                return LeaseStatus::Acquired;
+            }
+            else if (result == EOWNERDEAD)
+            {
+                pthread_mutex_consistent(&lease);
+                RecordOwner(owner);
+
+                return LeaseStatus::Recovered;
+            }
+            else if (result == EBUSY)
+            {
+                return LeaseStatus::HeldByLiveOwner;
+            }
+
+            throw std::system_error(result, std::system_category(), "pthread_mutex_trylock failed");
+        }
+
+        // Release a lease if the calling thread holds it.  Returns zero, or the error from the release - EPERM if the
+        // calling thread is not the holder.
+        static int ReleaseLease(pthread_mutex_t& lease, SharedLeaseOwner& owner)
+        {
+            if (owner.id.load(std::memory_order_acquire) != ThisThreadId())
+            {
+                return EPERM;
+            }
+
+            owner.id.store(0, std::memory_order_release);
+
+            return pthread_mutex_unlock(&lease);
+        }
+
+        static uint64_t ThisThreadId(void)
+        {
+            return ((static_cast<uint64_t>(getpid()) << 32) | static_cast<uint32_t>(syscall(SYS_gettid)));
+        }
+
+        // Record the calling thread as the holder of a lease.  The ID is cleared while the start time changes, so a
+        // reader that sees the same ID on both sides of its start time load has a matching pair.
+        static void RecordOwner(SharedLeaseOwner& owner)
+        {
+            const uint64_t id = ThisThreadId();
+
+            owner.id.store(0, std::memory_order_release);
+            owner.startTime.store(ThreadStartTime(id), std::memory_order_release);
+            owner.id.store(id, std::memory_order_release);
+        }
+
+        // Check the recorded holder of a lease is still running, and is the same thread rather than a later one with
+        // the same IDs.  A holder that has only just taken the lease may not have recorded itself yet, so it can
+        // briefly read as not alive.
+        static bool LeaseHeld(const SharedLeaseOwner& owner)
+        {
+            const uint64_t id = owner.id.load(std::memory_order_acquire);
+            const uint64_t startTime = owner.startTime.load(std::memory_order_acquire);
+            if ((id == 0) || (id != owner.id.load(std::memory_order_acquire)))
+            {
+                return false;
+            }
+
+            return ((startTime != 0) && (ThreadStartTime(id) == startTime));
+        }
+
+        // Start time of a thread in clock ticks since boot, from field 22 of its /proc stat file, or zero if the
+        // thread is not running or the file cannot be read.
+        static uint64_t ThreadStartTime(uint64_t id)
+        {
+            const std::string path =
+                ("/proc/" + std::to_string(id >> 32) + "/task/" + std::to_string(id & UINT32_MAX) + "/stat");
+            const int fd = open(path.c_str(), (O_RDONLY | O_CLOEXEC));
+            if (fd < 0)
+            {
+                return 0;
+            }
+
+            char buffer[1024];
+            const ssize_t size = read(fd, buffer, sizeof(buffer));
+            close(fd);
+            if (size <= 0)
+            {
+                return 0;
+            }
+
+            // The command name in field 2 can contain spaces and brackets, so count fields from its closing bracket.
+            // Field 22 starts after the twentieth space following it.
+            const std::string_view stat(buffer, static_cast<size_t>(size));
+            size_t position = stat.rfind(')');
+            for (int spaces = 0; (spaces < 20) && (position != std::string_view::npos); spaces++)
+            {
+                position = stat.find(' ', (position + 1));
+            }
+
+            uint64_t startTime = 0;
+            if (position != std::string_view::npos)
+            {
+                std::from_chars((stat.data() + position + 1), (stat.data() + stat.size()), startTime);
+            }
+
+            return startTime;
+        }
+
+        // Offset of the data region from the start of the mapping.
+        static constexpr size_t DataOffset(void)
+        {
+            constexpr size_t alignment = std::max(alignof(SharedFifoHeader), alignof(T));
+
+            return (((sizeof(SharedFifoHeader) + alignment - 1) / alignment) * alignment);
+        }
+
+        void Map(void)
+        {
+            void* mapping = mmap(nullptr, _mappingSize, (PROT_READ | PROT_WRITE), MAP_SHARED, _fd, 0);
+            if (mapping == MAP_FAILED)
+            {
+                const int error = errno;
+                close(_fd);
+                throw std::system_error(error, std::system_category(), "mmap failed");
+            }
+
+            _mapping = mapping;
+        }
+
+        void SetSpan(void)
+        {
+            T* data = reinterpret_cast<T*>(static_cast<std::byte*>(_mapping) + _header->dataOffset);
+            _ringBufferSpan = std::span<T>(data, maxSize);
+        }
+
+        // Check for space or data against the cached copy of the other side's cursor, see SpscNoCopyRingFifo.
+        inline bool HasReservableSpace(size_t size) const
+        {
+            return ((size <= (maxSize - (_reserveCursor - _cachedReadCursor))) || (size <= ReservableSize()));
+        }
+
+        inline bool HasReadableData(size_t size) const
+        {
+            return ((size <= (_cachedCommitCursor - _peekCursor)) || (size <= ReadableSize()));
+        }
+
+        // Size of the block for an up-to call, see SpscNoCopyRingFifo.
+        inline size_t ReserveUpToSize(size_t size, UpTo upTo) const
+        {
+            const size_t contiguous = (maxSize - static_cast<size_t>(_reserveCursor % maxSize));
+            const size_t limit = UpToSize(size, upTo, maxSize, contiguous);
+            const size_t cached = (maxSize - (_reserveCursor - _cachedReadCursor));
+
+            return std::min(limit, ((cached >= limit) ? cached : ReservableSize()));
+        }
+
+        inline size_t ReadUpToSize(size_t size, UpTo upTo) const
+        {
+            const size_t contiguous = (maxSize - static_cast<size_t>(_peekCursor % maxSize));
+            const size_t limit = UpToSize(size, upTo, maxSize, contiguous);
+            const size_t cached = (_cachedCommitCursor - _peekCursor);
+
+            return std::min(limit, ((cached >= limit) ? cached : ReadableSize()));
+        }
+
+        inline bool PeekOutstanding(void) const
+        {
+            return (_peekCursor != _header->readCursor.load(std::memory_order_relaxed));
+        }
+
+        // Update the FIFO state for a call whose size has already been checked, see NoCopyRingFifo.
+        inline DataBlock AdvanceReserve(size_t size)
+        {
+            DataBlock dataBlock = GetDataBlock(_reserveCursor, size);
+            _reserveCursor += size;
+
+            return dataBlock;
+        }
+
+        inline void AdvanceCommit(size_t size)
+        {
+            _header->commitCursor.store(
+                (_header->commitCursor.load(std::memory_order_relaxed) + size),
+                std::memory_order_release
+                );
+        }
+
+        inline void AdvanceCommitAndUnreserve(const DataBlock& dataBlock, size_t size)
+        {
+            AdvanceCommit(size);
+            _reserveCursor -= (dataBlock.size() - size);
+        }
+
+        inline void AdvanceReleaseAndUnpeek(const DataBlock& dataBlock, size_t size)
+        {
+            AdvanceRelease(size);
+            _peekCursor -= (dataBlock.size() - size);
+        }
+
+        inline DataBlock AdvanceRead(size_t size)
+        {
+            DataBlock dataBlock = AdvancePeek(size);
+            _header->readCursor.store(_peekCursor, std::memory_order_release);
+
+            return dataBlock;
+        }
+
+        inline DataBlock AdvancePeek(size_t size)
+        {
+            DataBlock dataBlock = GetDataBlock(_peekCursor, size);
+            _peekCursor += size;
+
+            return dataBlock;
+        }
+
+        inline void AdvanceRelease(size_t size)
+        {
+            _header->readCursor.store(
+                (_header->readCursor.load(std::memory_order_relaxed) + size),
+                std::memory_order_release
+                );
+        }
+
+        // Get a block of data starting at the specified cursor.
+        DataBlock GetDataBlock(uint64_t cursor, size_t size)
+        {
+            if (size == 0)
+            {
+                return DataBlock();
+            }
+
+            const size_t position = static_cast<size_t>(cursor % maxSize);
+            const size_t remainingBufferSize = (maxSize - position);
+            DataBlock dataBlock;
+
+            if (size > remainingBufferSize)
+            {
+                dataBlock = DataBlock(
+                    _ringBufferSpan.subspan(position, remainingBufferSize),
+                    _ringBufferSpan.subspan(0, (size - remainingBufferSize))
+                    );
+            }
+            else
+            {
+                dataBlock = DataBlock(_ringBufferSpan.subspan(position, size));
+            }
+
+            dataBlock.sequence = cursor;
+
+            return dataBlock;
+        }
+
+        int _fd = -1;
+        void* _mapping = nullptr;
+        size_t _mappingSize = 0;
+        SharedFifoHeader* _header = nullptr;
+        std::span<T> _ringBufferSpan;
+
+        // Process-local cursors, see SpscNoCopyRingFifo.  A process only uses the pair for its own side.
+        uint64_t _reserveCursor = 0;
+        mutable uint64_t _cachedReadCursor = 0;
+        uint64_t _peekCursor = 0;
+        mutable uint64_t _cachedCommitCursor = 0;
+
+        bool _producerLeaseHeld = false;
+        bool _consumerLeaseHeld = false;
+    };
+}
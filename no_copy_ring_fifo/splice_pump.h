@@ -0,0 +1,225 @@
+/*
+*   SplicePump class
+*
+*   Zero-copy forwarding of FIFO data with vmsplice and splice on Linux.  Fill vmsplices readable blocks of a
+*   NoCopyRingFifo of single-byte elements into a pipe the pump owns.  vmsplice does not copy the data - the pipe holds
+*   references to the FIFO's own pages - so the blocks stay peeked, out of the reservable space, until Reclaim sees
+*   they have been consumed from the pipe and releases them.  The pipe is first in, first out, so everything peeked
+*   but not still in the pipe is no longer referenced.
+*
+*   A pipe holds a number of page references rather than a number of bytes, and each page a vmsplice touches takes
+*   one of them, however little of the page it covers.  The pipe is sized to the pages the FIFO buffer touches where
+*   the system allows it, and PipeSize gives the size the kernel settled on.  Many small fills can still use it up,
+*   after which Fill returns EAGAIN until the pipe is read.
+*
+*   The pipe is only read by the pump, so nothing can take page references out of it unseen.  Read copies data out of
+*   the pipe, and Forward splices it on to a file.  Splicing into a regular file copies the data into the page cache,
+*   so the pages are free once the splice returns.  Splicing into another pipe or a socket would hand the page
+*   references on to somewhere Reclaim cannot see, so Forward refuses those.
+*
+*   Data coming in from a pipe has to be copied into the FIFO whichever call is used, so the input side is ReadFrom in
+*   fifo_io.h.  The pump must be the only user of the consumer side of the FIFO - Reclaim releases every peeked block
+*   that has left the pipe.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "fifo_io.h"
+
+namespace FifoTemplates
+{
+    template <typename Fifo> class SplicePump
+    {
+        static_assert(sizeof(typename Fifo::DataBlock::element_type) == 1, "SplicePump needs a FIFO of single-byte elements");
+
+    public:
+        // Create the pump's pipe, sized to the pages of the FIFO buffer where the system allows it.  Throws
+        // std::system_error if the pipe cannot be created.
+        SplicePump(Fifo& fifo) : _fifo(fifo)
+        {
+            int pipeFds[2];
+            if (pipe2(pipeFds, O_CLOEXEC) != 0)
+            {
+                throw std::system_error(errno, std::system_category(), "pipe2 failed");
+            }
+
+            _pipeReadFd = pipeFds[0];
+            _pipeWriteFd = pipeFds[1];
+
+            // Unprivileged processes cannot go past /proc/sys/fs/pipe-max-size, so keep the default size then.
+            const int wantedSize = static_cast<int>(std::min<size_t>(PagesPipeSize(), INT32_MAX));
+            int pipeSize = fcntl(_pipeWriteFd, F_SETPIPE_SZ, wantedSize);
+            if (pipeSize < 0)
+            {
+                pipeSize = fcntl(_pipeWriteFd, F_GETPIPE_SZ);
+            }
+
+            if (pipeSize < 0)
+            {
+                const int error = errno;
+                close(_pipeReadFd);
+                close(_pipeWriteFd);
+
+                throw std::system_error(error, std::system_category(), "pipe size query failed");
+            }
+
+            _pipeSize = static_cast<size_t>(pipeSize);
+        }
+
+        SplicePump(const SplicePump&) = delete;
+        SplicePump& operator=(const SplicePump&) = delete;
+
+        ~SplicePump()
+        {
+            close(_pipeReadFd);
+            close(_pipeWriteFd);
+        }
+
+        // Size of the pump's pipe in bytes, as set by the kernel.
+        inline size_t PipeSize(void) const { return _pipeSize; }
+
+        // vmsplice up to maxSize bytes of readable data into the pipe, leaving them peeked.  Returns the number of
+        // bytes spliced, zero if the FIFO is empty, or the error from vmsplice - EAGAIN when the pipe is full.
+        std::expected<size_t, std::error_code> Fill(size_t maxSize = SIZE_MAX)
+        {
+            const auto dataBlock = _fifo.PeekUpTo(maxSize);
+            const size_t size = dataBlock.size();
+            if (size == 0)
+            {
+                return 0;
+            }
+
+            // vmsplice ignores O_NONBLOCK on the pipe, so a full pipe would block without SPLICE_F_NONBLOCK.
+            const IoVecArray<2> ioVecs(dataBlock);
+            const ssize_t bytesSpliced =
+                vmsplice(_pipeWriteFd, ioVecs.data(), static_cast<size_t>(ioVecs.size()), SPLICE_F_NONBLOCK);
+
+            if (bytesSpliced < 0)
+            {
+                const int error = errno;
+                _fifo.Unpeek(size);
+
+                return std::unexpected(std::error_code(error, std::system_category()));
+            }
+
+            _fifo.Unpeek(size - static_cast<size_t>(bytesSpliced));
+
+            return static_cast<size_t>(bytesSpliced);
+        }
+
+        // Number of bytes waiting in the pipe, all of which still reference FIFO pages.
+        size_t Pending(void) const
+        {
+            int pending = 0;
+            ioctl(_pipeReadFd, FIONREAD, &pending);
+
+            return static_cast<size_t>(pending);
+        }
+
+        // Release the peeked bytes that have been consumed from the pipe.  Returns the number of bytes released.
+        size_t Reclaim(void)
+        {
+            const size_t consumed = (_fifo.ReleasableSize() - Pending());
+            _fifo.Release(consumed);
+
+            return consumed;
+        }
+
+        // Copy up to buffer.size() bytes out of the pipe and reclaim them.  Returns the number of bytes read, zero if
+        // the pipe is empty, or the error from read.
+        std::expected<size_t, std::error_code> Read(std::span<std::byte> buffer)
+        {
+            const size_t size = std::min(Pending(), buffer.size());
+            if (size == 0)
+            {
+                return 0;
+            }
+
+            const ssize_t bytesRead = read(_pipeReadFd, buffer.data(), size);
+            const int error = errno;
+
+            Reclaim();
+
+            if (bytesRead < 0)
+            {
+                return std::unexpected(std::error_code(error, std::system_category()));
+            }
+
+            return static_cast<size_t>(bytesRead);
+        }
+
+        // Fill the pipe, splice up to maxSize bytes from it into a file, and reclaim what was consumed.  Returns the
+        // number of bytes written to the file.  Pipes and sockets give std::errc::invalid_argument, as they would keep
+        // references to the pages after the splice.
+        std::expected<size_t, std::error_code> Forward(int fd, size_t maxSize = SIZE_MAX)
+        {
+            struct stat status;
+            if (fstat(fd, &status) != 0)
+            {
+                return std::unexpected(std::error_code(errno, std::system_category()));
+            }
+
+            if (S_ISFIFO(status.st_mode) || S_ISSOCK(status.st_mode))
+            {
+                return std::unexpected(std::make_error_code(std::errc::invalid_argument));
+            }
+
+            const auto bytesFilled = Fill(maxSize);
+            if (!bytesFilled.has_value() && (bytesFilled.error() != std::errc::resource_unavailable_try_again))
+            {
+                return bytesFilled;
+            }
+
+            const size_t size = std::min(Pending(), maxSize);
+            if (size == 0)
+            {
+                return 0;
+            }
+
+            const ssize_t bytesWritten = splice(_pipeReadFd, nullptr, fd, nullptr, size, SPLICE_F_MOVE);
+            const int error = errno;
+
+            Reclaim();
+
+            if (bytesWritten < 0)
+            {
+                return std::unexpected(std::error_code(error, std::system_category()));
+            }
+
+            return static_cast<size_t>(bytesWritten);
+        }
+
+    private:
+        // Pipe size in bytes for one page reference per page of the FIFO buffer, plus one as a wrapped block can put
+        // the page at the start of the buffer in the pipe a second time.
+        size_t PagesPipeSize(void) const
+        {
+            const auto buffer = std::as_bytes(_fifo.Buffer());
+            const uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+            const uintptr_t start = reinterpret_cast<uintptr_t>(buffer.data());
+            const uintptr_t firstPage = (start & ~(pageSize - 1));
+            const uintptr_t lastPage = ((start + buffer.size() - 1) & ~(pageSize - 1));
+
+            return static_cast<size_t>((((lastPage - firstPage) / pageSize) + 2) * pageSize);
+        }
+
+        Fifo& _fifo;
+        int _pipeReadFd = -1;
+        int _pipeWriteFd = -1;
+        size_t _pipeSize = 0;
+    };
+}
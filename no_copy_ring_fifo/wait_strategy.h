@@ -0,0 +1,267 @@
+/*
+*   Wait strategies
+*
+*   A wait strategy decides how a blocking Reserve or ReadBlock call of the concurrent FIFOs waits for the other side
+*   to change the FIFO state.  The waiting thread calls Wait with a predicate over the FIFO state and a deadline, and
+*   the thread that changes the state calls Notify afterwards.  Each FIFO side owns one strategy object.
+*
+*   - YieldWait is the default.  It gives the CPU back to the scheduler between checks, so a blocked call keeps a CPU
+*     busy polling, but its Notify is empty and commits and releases pay nothing for the blocking calls.
+*   - ParkWait sleeps on a futex (std::atomic::wait off Linux).  Notify only makes a system call when a thread is
+*     actually parked, but every Notify pays a fence and a load of the waiter count, so it is for FIFOs that mostly
+*     use the blocking calls.  std::atomic::wait has no timeout, so off Linux a wait with a deadline sleeps in steps
+*     that grow to a millisecond and can wake up to that late.
+*   - SpinParkWait spins for a while before parking, for waits that are usually short.
+*   - BusySpinWait spins on the CPU pause instruction, for the lowest wake latency at the cost of a whole core.
+*   - SleepWait sleeps for a fixed period between checks, for batch work where latency does not matter.
+*
+*   The polling strategies need no notification, so their Notify is empty and the non-blocking calls cost nothing
+*   extra.  They should not be used where the two sides share a CPU, as a spinning waiter then holds up the thread it
+*   is waiting for until it is preempted.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace FifoTemplates
+{
+    using WaitClock = std::chrono::steady_clock;
+
+    // Timeout for the blocking FIFO calls that never expires.
+    inline constexpr std::chrono::nanoseconds waitForever = std::chrono::nanoseconds::max();
+
+    // Return the deadline for a timeout starting now, saturating rather than overflowing for long timeouts.
+    inline WaitClock::time_point WaitDeadline(std::chrono::nanoseconds timeout)
+    {
+        const WaitClock::time_point now = WaitClock::now();
+
+        if (timeout >= std::chrono::duration_cast<std::chrono::nanoseconds>(WaitClock::time_point::max() - now))
+        {
+            return WaitClock::time_point::max();
+        }
+
+        return (now + std::chrono::duration_cast<WaitClock::duration>(timeout));
+    }
+
+    // Tell the CPU this is a spin-wait loop, which saves power and frees resources for a sibling hyperthread.
+    inline void CpuRelax(void)
+    {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+        _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        asm volatile("yield");
+#endif
+    }
+
+    // Sleep on a futex until notified.
+    class ParkWait
+    {
+    public:
+        // Block until ready() returns true, or the deadline passes.  Returns the last result of ready().
+        template <typename Predicate> bool Wait(Predicate&& ready, WaitClock::time_point deadline)
+        {
+            while (!ready())
+            {
+                // Register before the final check of the state.  Either this check sees the notifier's change, or the
+                // notifier's fence orders its load of the waiter count after the registration and it wakes us.  The
+                // epoch is acquired so a wake from a later Notify also carries the change stored before it.
+                _waiters.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+
+                const uint32_t epoch = _epoch.load(std::memory_order_acquire);
+                bool timedOut = false;
+                if (!ready())
+                {
+                    timedOut = !Sleep(epoch, deadline);
+                }
+
+                _waiters.fetch_sub(1, std::memory_order_relaxed);
+
+                if (timedOut)
+                {
+                    return ready();
+                }
+            }
+
+            return true;
+        }
+
+        // Wake every waiting thread.  Must be called after the change to the FIFO state has been stored.
+        inline void Notify(void)
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (_waiters.load(std::memory_order_relaxed) != 0)
+            {
+                _epoch.fetch_add(1, std::memory_order_release);
+                Wake();
+            }
+        }
+
+    private:
+#if !defined(__linux__)
+        static constexpr std::chrono::microseconds maxSleepStep{ 1000 };
+#endif
+
+        // Sleep while the epoch is unchanged.  Returns false once the deadline has passed.  May return early.
+        bool Sleep(uint32_t epoch, WaitClock::time_point deadline)
+        {
+#if defined(__linux__)
+            if (deadline == WaitClock::time_point::max())
+            {
+                syscall(SYS_futex, &_epoch, FUTEX_WAIT_PRIVATE, epoch, nullptr, nullptr, 0);
+
+                return true;
+            }
+
+            const WaitClock::duration remaining = (deadline - WaitClock::now());
+            if (remaining <= WaitClock::duration::zero())
+            {
+                return false;
+            }
+
+            const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(remaining);
+            const timespec timeout = {
+                static_cast<time_t>(seconds.count()),
+                static_cast<long>(std::chrono::duration_cast<std::chrono::nanoseconds>(remaining - seconds).count())
+            };
+            syscall(SYS_futex, &_epoch, FUTEX_WAIT_PRIVATE, epoch, &timeout, nullptr, 0);
+
+            return true;
+#else
+            if (deadline == WaitClock::time_point::max())
+            {
+                _epoch.wait(epoch, std::memory_order_acquire);
+
+                return true;
+            }
+
+            std::chrono::microseconds step(1);
+            while (_epoch.load(std::memory_order_acquire) == epoch)
+            {
+                const WaitClock::time_point now = WaitClock::now();
+                if (now >= deadline)
+                {
+                    return false;
+                }
+
+                std::this_thread::sleep_for(std::min<WaitClock::duration>(step, (deadline - now)));
+                step = std::min((step * 2), maxSleepStep);
+            }
+
+            return true;
+#endif
+        }
+
+        inline void Wake(void)
+        {
+#if defined(__linux__)
+            syscall(SYS_futex, &_epoch, FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+#else
+            _epoch.notify_all();
+#endif
+        }
+
+        std::atomic<uint32_t> _epoch = 0;
+        std::atomic<uint32_t> _waiters = 0;
+    };
+
+    // Poll the predicate until it is true or the deadline passes, calling pause() between polls.  The clock is only
+    // read every few polls, and not at all without a deadline.
+    template <typename Predicate, typename Pause>
+    bool PollUntil(Predicate&& ready, WaitClock::time_point deadline, Pause&& pause, size_t pollsPerClockCheck)
+    {
+        for (size_t polls = 1; !ready(); polls++)
+        {
+            if ((deadline != WaitClock::time_point::max()) &&
+                ((polls % pollsPerClockCheck) == 0) &&
+                (WaitClock::now() >= deadline))
+            {
+                return ready();
+            }
+
+            pause();
+        }
+
+        return true;
+    }
+
+    // Spin on the CPU pause instruction.
+    class BusySpinWait
+    {
+    public:
+        template <typename Predicate> bool Wait(Predicate&& ready, WaitClock::time_point deadline)
+        {
+            return PollUntil(ready, deadline, CpuRelax, 64);
+        }
+
+        inline void Notify(void) {}
+    };
+
+    // Yield the CPU between checks.
+    class YieldWait
+    {
+    public:
+        template <typename Predicate> bool Wait(Predicate&& ready, WaitClock::time_point deadline)
+        {
+            return PollUntil(ready, deadline, [] { std::this_thread::yield(); }, 8);
+        }
+
+        inline void Notify(void) {}
+    };
+
+    // Sleep for a fixed number of microseconds between checks.
+    template <uint32_t PeriodMicroseconds = 50> class SleepWait
+    {
+    public:
+        template <typename Predicate> bool Wait(Predicate&& ready, WaitClock::time_point deadline)
+        {
+            const std::chrono::microseconds period(PeriodMicroseconds);
+
+            return PollUntil(ready, deadline, [&] { std::this_thread::sleep_for(period); }, 1);
+        }
+
+        inline void Notify(void) {}
+    };
+
+    // Spin for a number of polls, then park.
+    template <uint32_t SpinCount = 1024> class SpinParkWait
+    {
+    public:
+        template <typename Predicate> bool Wait(Predicate&& ready, WaitClock::time_point deadline)
+        {
+            for (uint32_t spin = 0; spin < SpinCount; spin++)
+            {
+                if (ready())
+                {
+                    return true;
+                }
+
+                CpuRelax();
+            }
+
+            return _park.Wait(ready, deadline);
+        }
+
+        inline void Notify(void) { _park.Notify(); }
+
+    private:
+        ParkWait _park;
+    };
+}
@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <format>
+#include <numeric>
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "fifo_test_fixture.h"
+#include "fifo_io.h"
+
+using namespace FifoTemplates;
+
+typedef NoCopyRingFifo<uint8_t> ByteFifo;
+
+// Test building iovec entries from single and wrapped blocks, and from a batch of blocks.
+TEST(FifoIoTest, IoVecArray)
+{
+    NoCopyRingFifo<fifoDataType> fifo(10);
+
+    auto ioVecs = ToIoVec(fifo.Reserve(4));
+    ASSERT_EQ(ioVecs.size(), 1);
+    EXPECT_EQ(ioVecs.Bytes(), (4 * sizeof(fifoDataType)));
+    fifo.Commit(4);
+    fifo.ReadBlock(4);
+
+    fifo.Reserve(4);
+    auto wrappedBlock = fifo.Reserve(4);
+    ASSERT_TRUE(wrappedBlock.isSplit());
+
+    ioVecs = ToIoVec(wrappedBlock);
+    ASSERT_EQ(ioVecs.size(), 2);
+    EXPECT_EQ(ioVecs.data()[0].iov_base, wrappedBlock.spans[0].data());
+    EXPECT_EQ(ioVecs.data()[0].iov_len, (2 * sizeof(fifoDataType)));
+    EXPECT_EQ(ioVecs.data()[1].iov_base, wrappedBlock.spans[1].data());
+    EXPECT_EQ(ioVecs.data()[1].iov_len, (2 * sizeof(fifoDataType)));
+
+    IoVecArray<3> batch;
+    EXPECT_TRUE(batch.Add(NoCopyRingFifo<fifoDataType>::DataBlock()));
+    EXPECT_EQ(batch.size(), 0);
+    EXPECT_TRUE(batch.Add(wrappedBlock));
+    EXPECT_FALSE(batch.Add(wrappedBlock));
+    EXPECT_EQ(batch.size(), 2);
+    EXPECT_EQ(batch.Span().size(), 2);
+}
+
+// Move data through a pipe with ReadFrom and WriteTo, wrapping around the FIFO buffer, and check short transfers
+// commit and release only what moved.
+TEST(FifoIoTest, ReadFromWriteTo)
+{
+    int pipeFds[2];
+    ASSERT_EQ(pipe2(pipeFds, O_NONBLOCK), 0);
+
+    std::array<uint8_t, 256> source;
+    std::iota(source.begin(), source.end(), 0);
+
+    ByteFifo fifo(100);
+    size_t written = 0;
+    size_t read = 0;
+
+    for (size_t pass = 0; pass < 20; pass++)
+    {
+        SCOPED_TRACE(std::format("Pass {}\r\n", pass));
+
+        // Put a short run into the pipe, so ReadFrom gets less than it reserved.
+        const size_t chunk = ((pass * 7) % 60) + 1;
+        ASSERT_EQ(write(pipeFds[1], (source.data() + (written % 196)), chunk), static_cast<ssize_t>(chunk));
+        written += chunk;
+
+        auto bytesRead = ReadFrom(fifo, pipeFds[0]);
+        ASSERT_TRUE(bytesRead.has_value());
+        EXPECT_EQ(*bytesRead, chunk);
+        EXPECT_EQ(fifo.CommitableSize(), 0);
+        EXPECT_EQ(fifo.ReadableSize(), chunk);
+
+        // Nothing left in the pipe.
+        auto emptyRead = ReadFrom(fifo, pipeFds[0]);
+        ASSERT_FALSE(emptyRead.has_value());
+        EXPECT_EQ(emptyRead.error(), std::errc::resource_unavailable_try_again);
+        EXPECT_EQ(fifo.ReadableSize(), chunk);
+
+        // Write out in two parts, the first of them limited.
+        auto bytesWritten = WriteTo(fifo, pipeFds[1], (chunk / 2));
+        ASSERT_TRUE(bytesWritten.has_value());
+        EXPECT_EQ(*bytesWritten, (chunk / 2));
+        EXPECT_EQ(fifo.ReleasableSize(), 0);
+        bytesWritten = WriteTo(fifo, pipeFds[1]);
+        ASSERT_TRUE(bytesWritten.has_value());
+        EXPECT_EQ(*bytesWritten, (chunk - (chunk / 2)));
+        EXPECT_EQ(fifo.ReadableSize(), 0);
+
+        // Check the round trip through the FIFO and pipe.
+        std::array<uint8_t, 64> check;
+        ASSERT_EQ(::read(pipeFds[0], check.data(), check.size()), static_cast<ssize_t>(chunk));
+        EXPECT_TRUE(std::equal(check.begin(), (check.begin() + chunk), (source.begin() + (read % 196))));
+        read += chunk;
+    }
+
+    // Outstanding reservations or peeks are refused, leaving the caller's blocks and the pipe alone.
+    ASSERT_EQ(write(pipeFds[1], source.data(), 4), 4);
+    fifo.Reserve(3);
+    auto busyRead = ReadFrom(fifo, pipeFds[0]);
+    ASSERT_FALSE(busyRead.has_value());
+    EXPECT_EQ(busyRead.error(), std::errc::device_or_resource_busy);
+    EXPECT_EQ(fifo.CommitableSize(), 3);
+    EXPECT_EQ(fifo.ReadableSize(), 0);
+    fifo.Commit(3);
+    fifo.PeekBlock(1);
+    auto busyWrite = WriteTo(fifo, pipeFds[1]);
+    ASSERT_FALSE(busyWrite.has_value());
+    EXPECT_EQ(busyWrite.error(), std::errc::device_or_resource_busy);
+    EXPECT_EQ(fifo.ReleasableSize(), 1);
+    EXPECT_EQ(fifo.ReadableSize(), 2);
+    fifo.Release(1);
+    fifo.ReadBlock(2);
+    std::array<uint8_t, 4> drain;
+    ASSERT_EQ(::read(pipeFds[0], drain.data(), drain.size()), 4);
+
+    // A full FIFO is not reported as end of file.
+    fifo.Reserve(fifo.ReservableSize());
+    fifo.Commit(fifo.CommitableSize());
+    auto fullRead = ReadFrom(fifo, pipeFds[0]);
+    ASSERT_FALSE(fullRead.has_value());
+    EXPECT_EQ(fullRead.error(), std::errc::no_buffer_space);
+
+    // End of file.
+    fifo.Reset();
+    close(pipeFds[1]);
+    auto endRead = ReadFrom(fifo, pipeFds[0]);
+    ASSERT_TRUE(endRead.has_value());
+    EXPECT_EQ(*endRead, 0);
+    EXPECT_EQ(fifo.ReservableSize(), 100);
+
+    close(pipeFds[0]);
+}
+
+// Test handing back reserved and peeked elements.
+TEST_F(FifoTest, UnreserveUnpeek)
+{
+    fifo.Reset();
+
+    ASSERT_NO_THROW(fifo.Reserve(6));
+    EXPECT_THROW(fifo.Unreserve(7), std::overflow_error);
+    ASSERT_NO_THROW(fifo.Unreserve(2));
+    EXPECT_EQ(fifo.CommitableSize(), 4);
+    EXPECT_EQ(fifo.ReservableSize(), 6);
+    ASSERT_NO_THROW(fifo.Commit(4));
+
+    ASSERT_NO_THROW(fifo.PeekBlock(3));
+    EXPECT_THROW(fifo.Unpeek(4), std::underflow_error);
+    ASSERT_NO_THROW(fifo.Unpeek(1));
+    EXPECT_EQ(fifo.ReleasableSize(), 2);
+    EXPECT_EQ(fifo.ReadableSize(), 2);
+
+    NoCopyRingFifo<fifoDataType>::DataBlock dataBlock;
+    ASSERT_NO_THROW(dataBlock = fifo.PeekBlock(2));
+    EXPECT_EQ(dataBlock.sequence, 2);
+}
+
+// Test committing or releasing the start of a block and handing back the rest of it in one call.
+TEST_F(FifoTest, CommitAndUnreserve)
+{
+    fifo.Reset();
+
+    NoCopyRingFifo<fifoDataType>::DataBlock inDataBlock;
+    ASSERT_NO_THROW(inDataBlock = fifo.Reserve(6));
+    EXPECT_THROW(fifo.CommitAndUnreserve(inDataBlock, 7), std::overflow_error);
+    ASSERT_NO_THROW(fifo.CommitAndUnreserve(inDataBlock, 4));
+    EXPECT_EQ(fifo.CommitableSize(), 0);
+    EXPECT_EQ(fifo.ReadableSize(), 4);
+    EXPECT_EQ(fifo.ReservableSize(), 6);
+
+    // Abandoning a reservation gives all of it back.
+    ASSERT_NO_THROW(inDataBlock = fifo.Reserve(6));
+    ASSERT_NO_THROW(fifo.CommitAndUnreserve(inDataBlock, 0));
+    EXPECT_EQ(fifo.ReservableSize(), 6);
+
+    NoCopyRingFifo<fifoDataType>::DataBlock outDataBlock;
+    ASSERT_NO_THROW(outDataBlock = fifo.PeekBlock(4));
+    EXPECT_THROW(fifo.ReleaseAndUnpeek(outDataBlock, 5), std::underflow_error);
+    ASSERT_NO_THROW(fifo.ReleaseAndUnpeek(outDataBlock, 1));
+    EXPECT_EQ(fifo.ReleasableSize(), 0);
+    EXPECT_EQ(fifo.ReadableSize(), 3);
+    EXPECT_EQ(fifo.ReservableSize(), 7);
+
+    ASSERT_NO_THROW(outDataBlock = fifo.PeekBlock(3));
+    EXPECT_EQ(outDataBlock.sequence, 1);
+    ASSERT_NO_THROW(fifo.Release(3));
+
+    // With two blocks outstanding, only the newest can be handed back and only the oldest committed, so neither can
+    // do both.
+    NoCopyRingFifo<fifoDataType>::DataBlock firstDataBlock;
+    NoCopyRingFifo<fifoDataType>::DataBlock secondDataBlock;
+    ASSERT_NO_THROW(firstDataBlock = fifo.Reserve(2));
+    ASSERT_NO_THROW(secondDataBlock = fifo.Reserve(3));
+    EXPECT_THROW(fifo.CommitAndUnreserve(firstDataBlock, 1), std::overflow_error);
+    EXPECT_THROW(fifo.CommitAndUnreserve(firstDataBlock, 0), std::overflow_error);
+    EXPECT_THROW(fifo.CommitAndUnreserve(secondDataBlock, 1), std::overflow_error);
+    EXPECT_EQ(fifo.CommitableSize(), 5);
+
+    // Handing back the newest block leaves the oldest reserved, and committing the oldest in full is allowed while
+    // a newer block is outstanding.
+    ASSERT_NO_THROW(fifo.CommitAndUnreserve(secondDataBlock, 0));
+    EXPECT_EQ(fifo.CommitableSize(), 2);
+    ASSERT_NO_THROW(secondDataBlock = fifo.Reserve(3));
+    ASSERT_NO_THROW(fifo.CommitAndUnreserve(firstDataBlock, 2));
+    ASSERT_NO_THROW(fifo.CommitAndUnreserve(secondDataBlock, 1));
+    EXPECT_EQ(fifo.CommitableSize(), 0);
+    EXPECT_EQ(fifo.ReadableSize(), 3);
+
+    // The same holds for peeks.
+    ASSERT_NO_THROW(firstDataBlock = fifo.PeekBlock(1));
+    ASSERT_NO_THROW(secondDataBlock = fifo.PeekBlock(2));
+    EXPECT_THROW(fifo.ReleaseAndUnpeek(firstDataBlock, 0), std::underflow_error);
+    EXPECT_THROW(fifo.ReleaseAndUnpeek(secondDataBlock, 1), std::underflow_error);
+    ASSERT_NO_THROW(fifo.ReleaseAndUnpeek(firstDataBlock, 1));
+    ASSERT_NO_THROW(fifo.ReleaseAndUnpeek(secondDataBlock, 1));
+    EXPECT_EQ(fifo.ReleasableSize(), 0);
+    EXPECT_EQ(fifo.ReadableSize(), 1);
+    ASSERT_NO_THROW(outDataBlock = fifo.PeekBlock(1));
+    EXPECT_EQ(outDataBlock.sequence, (secondDataBlock.sequence + 1));
+}
@@ -219,4 +219,464 @@ TEST_F(FifoTest, Wraparound)
             EXPECT_EQ(inDataBlock.spans[1][i], outDataBlock.spans[1][i]);
         }
     }
-}
\ No newline at end of file
+}
+
+// Test that peeked data stays out of the reservable space until it is released.
+TEST_F(FifoTest, PeekRelease)
+{
+    for (int blockSize = 1; blockSize < maxFifoSize; blockSize++)
+    {
+        SCOPED_TRACE(std::format("Peek block loop iteration {}\r\n", blockSize));
+
+        fifo.Reset();
+
+        ASSERT_NO_THROW(fifo.Reserve(maxFifoSize));
+        ASSERT_NO_THROW(fifo.Commit(maxFifoSize));
+
+        // Peek a block.  The space is no longer readable, but not yet reservable either.
+        NoCopyRingFifo<fifoDataType>::DataBlock outDataBlock;
+        ASSERT_NO_THROW(outDataBlock = fifo.PeekBlock(blockSize));
+        EXPECT_EQ(outDataBlock.spans[0].size(), blockSize);
+        EXPECT_EQ(outDataBlock.isValid(), true);
+        EXPECT_EQ(outDataBlock.isSplit(), false);
+
+        EXPECT_EQ(fifo.ReadableSize(), (maxFifoSize - blockSize));
+        EXPECT_EQ(fifo.ReleasableSize(), blockSize);
+        EXPECT_EQ(fifo.ReservableSize(), 0);
+        EXPECT_THROW(fifo.Reserve(1), std::overflow_error);
+
+        // Release more than was peeked, should throw.
+        EXPECT_THROW(fifo.Release(blockSize + 1), std::underflow_error);
+
+        // Release the block, making it reservable again.
+        ASSERT_NO_THROW(fifo.Release(blockSize));
+        EXPECT_EQ(fifo.ReleasableSize(), 0);
+        EXPECT_EQ(fifo.ReservableSize(), blockSize);
+
+        // The next peek continues after the released block.
+        NoCopyRingFifo<fifoDataType>::DataBlock nextDataBlock;
+        ASSERT_NO_THROW(nextDataBlock = fifo.PeekBlock(1));
+        EXPECT_EQ(nextDataBlock.spans[0].data(), (outDataBlock.spans[0].data() + blockSize));
+    }
+}
+
+// Test that a read cannot free peeked data that has not been released yet.
+TEST_F(FifoTest, ReadWhilePeeked)
+{
+    NoCopyRingFifo<fifoDataType>::DataBlock inDataBlock;
+    ASSERT_NO_THROW(inDataBlock = fifo.Reserve(8));
+    for (size_t i = 0; i < 8; i++)
+    {
+        inDataBlock.spans[0][i] = static_cast<fifoDataType>(i);
+    }
+    ASSERT_NO_THROW(fifo.Commit(8));
+
+    NoCopyRingFifo<fifoDataType>::DataBlock peekedDataBlock;
+    ASSERT_NO_THROW(peekedDataBlock = fifo.PeekBlock(4));
+
+    // The read would free the peeked block along with its own, so it is refused and nothing changes.
+    EXPECT_THROW(fifo.ReadBlock(4), std::logic_error);
+    EXPECT_THROW(fifo.ReadUpTo(4), std::logic_error);
+    auto readResult = fifo.TryReadBlock(4);
+    ASSERT_FALSE(readResult.has_value());
+    EXPECT_EQ(readResult.error(), FifoError::PeekOutstanding);
+    EXPECT_EQ(fifo.ReleasableSize(), 4);
+    EXPECT_EQ(fifo.ReadableSize(), 4);
+
+    // Only the space that was never written is reservable, so the peeked data is intact.
+    EXPECT_EQ(fifo.ReservableSize(), (maxFifoSize - 8));
+    ASSERT_NO_THROW(fifo.Reserve(fifo.ReservableSize()));
+    for (size_t i = 0; i < 4; i++)
+    {
+        EXPECT_EQ(peekedDataBlock.spans[0][i], i);
+    }
+
+    // Once the peek is released the read goes ahead.
+    ASSERT_NO_THROW(fifo.Release(4));
+    NoCopyRingFifo<fifoDataType>::DataBlock outDataBlock;
+    ASSERT_NO_THROW(outDataBlock = fifo.ReadBlock(4));
+    EXPECT_EQ(outDataBlock.spans[0][0], 4);
+}
+
+// Test that the power of two capacity policy rounds the FIFO size up and still wraps correctly.
+TEST(PowerOfTwoFifoTest, Wraparound)
+{
+    typedef NoCopyRingFifo<fifoDataType, VectorStorage<fifoDataType>, PowerOfTwoCapacity> PowerOfTwoFifo;
+
+    PowerOfTwoFifo fifo(10);
+    ASSERT_EQ(fifo.maxSize, 16);
+    EXPECT_EQ(fifo.ReservableSize(), 16);
+
+    for (size_t blockSize = 2; blockSize < fifo.maxSize; blockSize++)
+    {
+        SCOPED_TRACE(std::format("Wraparound block loop iteration {}\r\n", blockSize));
+
+        fifo.Reset();
+
+        ASSERT_NO_THROW(fifo.Reserve(fifo.maxSize - 1));
+        ASSERT_NO_THROW(fifo.Commit(fifo.maxSize - 1));
+        ASSERT_NO_THROW(fifo.ReadBlock(fifo.maxSize - 1));
+
+        PowerOfTwoFifo::DataBlock inDataBlock;
+        ASSERT_NO_THROW(inDataBlock = fifo.Reserve(blockSize));
+        EXPECT_EQ(inDataBlock.spans[0].size(), 1);
+        EXPECT_EQ(inDataBlock.spans[1].size(), (blockSize - 1));
+        ASSERT_NO_THROW(fifo.Commit(blockSize));
+
+        // The next block starts straight after the wrapped one.
+        ASSERT_NO_THROW(fifo.ReadBlock(blockSize));
+        ASSERT_NO_THROW(fifo.Reserve(1));
+        ASSERT_NO_THROW(fifo.Commit(1));
+
+        PowerOfTwoFifo::DataBlock outDataBlock;
+        ASSERT_NO_THROW(outDataBlock = fifo.ReadBlock(1));
+        EXPECT_EQ(outDataBlock.spans[0].data(), (inDataBlock.spans[1].data() + (blockSize - 1)));
+    }
+}
+
+// Test that the non-throwing calls report a full or empty FIFO through the returned error.
+TEST_F(FifoTest, TryCalls)
+{
+    fifo.Reset();
+
+    auto commitResult = fifo.TryCommit(1);
+    ASSERT_FALSE(commitResult.has_value());
+    EXPECT_EQ(commitResult.error(), FifoError::InsufficientReserved);
+
+    auto readResult = fifo.TryReadBlock(1);
+    ASSERT_FALSE(readResult.has_value());
+    EXPECT_EQ(readResult.error(), FifoError::InsufficientData);
+
+    auto peekResult = fifo.TryPeekBlock(1);
+    ASSERT_FALSE(peekResult.has_value());
+    EXPECT_EQ(peekResult.error(), FifoError::InsufficientData);
+
+    auto releaseResult = fifo.TryRelease(1);
+    ASSERT_FALSE(releaseResult.has_value());
+    EXPECT_EQ(releaseResult.error(), FifoError::InsufficientPeeked);
+
+    auto reserveResult = fifo.TryReserve(maxFifoSize);
+    ASSERT_TRUE(reserveResult.has_value());
+    EXPECT_EQ(reserveResult->spans[0].size(), maxFifoSize);
+
+    reserveResult = fifo.TryReserve(1);
+    ASSERT_FALSE(reserveResult.has_value());
+    EXPECT_EQ(reserveResult.error(), FifoError::InsufficientSpace);
+
+    // Failed calls leave the FIFO state unchanged.
+    EXPECT_EQ(fifo.ReservableSize(), 0);
+    EXPECT_EQ(fifo.CommitableSize(), maxFifoSize);
+
+    EXPECT_TRUE(fifo.TryCommit(maxFifoSize).has_value());
+    EXPECT_TRUE(fifo.TryPeekBlock(maxFifoSize).has_value());
+    EXPECT_TRUE(fifo.TryRelease(maxFifoSize).has_value());
+    EXPECT_EQ(fifo.ReservableSize(), maxFifoSize);
+}
+
+// Test that the abort error policy aborts on failure instead of throwing.
+TEST(AbortErrorPolicyTest, Abort)
+{
+    NoCopyRingFifo<fifoDataType, VectorStorage<fifoDataType>, ModuloCapacity, AbortErrorPolicy> fifo(1);
+
+    EXPECT_DEATH(fifo.Commit(1), "");
+    EXPECT_TRUE(fifo.TryReserve(1).has_value());
+}
+
+// Test a FIFO over uninitialised storage, and that prefaulting and locking the buffer leave its contents intact.
+TEST(UninitializedStorageTest, PrefaultAndLock)
+{
+    typedef NoCopyRingFifo<fifoDataType, UninitializedStorage<fifoDataType>> UninitializedFifo;
+
+    constexpr size_t fifoSize = 4096;
+    UninitializedFifo fifo(fifoSize);
+
+    UninitializedFifo::DataBlock inDataBlock;
+    ASSERT_NO_THROW(inDataBlock = fifo.Reserve(fifoSize));
+    for (size_t i = 0; i < fifoSize; i++)
+    {
+        inDataBlock.spans[0][i] = static_cast<fifoDataType>(i);
+    }
+    ASSERT_NO_THROW(fifo.Commit(fifoSize));
+
+    fifo.Prefault();
+
+#if defined(__unix__) || defined(__APPLE__)
+    // Locking may be refused by the memory lock limit, but must not disturb the data either way.
+    fifo.LockMemory();
+#endif
+
+    UninitializedFifo::DataBlock outDataBlock;
+    ASSERT_NO_THROW(outDataBlock = fifo.ReadBlock(fifoSize));
+    bool intact = true;
+    for (size_t i = 0; i < fifoSize; i++)
+    {
+        intact = intact && (outDataBlock.spans[0][i] == static_cast<fifoDataType>(i));
+    }
+    EXPECT_TRUE(intact);
+}
+
+namespace
+{
+    // Allocator that counts the elements it allocates, to check that the storage allocates through it.
+    template <typename T> class CountingAllocator
+    {
+    public:
+        using value_type = T;
+
+        CountingAllocator(size_t& allocated) : allocated(allocated) {}
+        template <typename U> CountingAllocator(const CountingAllocator<U>& other) : allocated(other.allocated) {}
+
+        T* allocate(size_t count)
+        {
+            allocated += count;
+            return std::allocator<T>().allocate(count);
+        }
+
+        void deallocate(T* data, size_t count) { std::allocator<T>().deallocate(data, count); }
+
+        bool operator==(const CountingAllocator& other) const { return (&allocated == &other.allocated); }
+
+        size_t& allocated;
+    };
+}
+
+// Test a FIFO over memory owned by the caller.
+TEST(StorageTest, Span)
+{
+    typedef NoCopyRingFifo<fifoDataType, SpanStorage<fifoDataType>> SpanFifo;
+
+    std::vector<fifoDataType> buffer(10);
+    SpanFifo fifo{ SpanStorage<fifoDataType>(buffer) };
+    EXPECT_EQ(fifo.maxSize, buffer.size());
+
+    SpanFifo::DataBlock dataBlock;
+    ASSERT_NO_THROW(dataBlock = fifo.Reserve(3));
+    EXPECT_EQ(dataBlock.spans[0].data(), buffer.data());
+
+    // The storage size must suit the capacity policy.
+    typedef NoCopyRingFifo<fifoDataType, SpanStorage<fifoDataType>, PowerOfTwoCapacity> PowerOfTwoSpanFifo;
+    EXPECT_THROW(PowerOfTwoSpanFifo{ SpanStorage<fifoDataType>(buffer) }, std::invalid_argument);
+    EXPECT_NO_THROW(PowerOfTwoSpanFifo{ SpanStorage<fifoDataType>(std::span(buffer).first(8)) });
+}
+
+// Test a FIFO held inline in a std::array.
+TEST(StorageTest, Array)
+{
+    typedef NoCopyRingFifo<fifoDataType, ArrayStorage<fifoDataType, 10>> ArrayFifo;
+
+    ArrayFifo fifo(10);
+    EXPECT_EQ(fifo.maxSize, 10);
+    EXPECT_THROW(ArrayFifo(11), std::invalid_argument);
+
+    ArrayFifo::DataBlock dataBlock;
+    ASSERT_NO_THROW(dataBlock = fifo.Reserve(10));
+    EXPECT_GE(reinterpret_cast<const void*>(dataBlock.spans[0].data()), reinterpret_cast<const void*>(&fifo));
+    EXPECT_LT(reinterpret_cast<const void*>(dataBlock.spans[0].data()), reinterpret_cast<const void*>(&fifo + 1));
+}
+
+// Test a FIFO whose vector storage allocates through a caller-supplied allocator.
+TEST(StorageTest, Allocator)
+{
+    typedef VectorStorage<fifoDataType, CountingAllocator<fifoDataType>> CountingStorage;
+    typedef NoCopyRingFifo<fifoDataType, CountingStorage> CountingFifo;
+
+    size_t allocated = 0;
+    CountingFifo fifo{ CountingStorage(10, CountingAllocator<fifoDataType>(allocated)) };
+    EXPECT_EQ(fifo.maxSize, 10);
+    EXPECT_EQ(allocated, 10);
+
+    ASSERT_NO_THROW(fifo.Commit(fifo.Reserve(10).size()));
+    EXPECT_EQ(fifo.ReadableSize(), 10);
+}
+
+// Test FIFOs with a capacity fixed at compile time, with both power of two and other sizes.
+TEST(FixedCapacityFifoTest, Wraparound)
+{
+    typedef FixedNoCopyRingFifo<fifoDataType, 16> PowerOfTwoFixedFifo;
+    typedef FixedNoCopyRingFifo<fifoDataType, 10> FixedFifo;
+
+    PowerOfTwoFixedFifo powerOfTwoFifo;
+    EXPECT_EQ(powerOfTwoFifo.maxSize, 16);
+    EXPECT_EQ(powerOfTwoFifo.ReservableSize(), 16);
+    EXPECT_THROW(PowerOfTwoFixedFifo(10), std::invalid_argument);
+
+    FixedFifo fifo;
+    ASSERT_EQ(fifo.maxSize, 10);
+
+    for (size_t blockSize = 2; blockSize < fifo.maxSize; blockSize++)
+    {
+        SCOPED_TRACE(std::format("Wraparound block loop iteration {}\r\n", blockSize));
+
+        fifo.Reset();
+
+        ASSERT_NO_THROW(fifo.Reserve(fifo.maxSize - 1));
+        ASSERT_NO_THROW(fifo.Commit(fifo.maxSize - 1));
+        ASSERT_NO_THROW(fifo.ReadBlock(fifo.maxSize - 1));
+
+        FixedFifo::DataBlock inDataBlock;
+        ASSERT_NO_THROW(inDataBlock = fifo.Reserve(blockSize));
+        EXPECT_EQ(inDataBlock.spans[0].size(), 1);
+        EXPECT_EQ(inDataBlock.spans[1].size(), (blockSize - 1));
+        ASSERT_NO_THROW(fifo.Commit(blockSize));
+
+        FixedFifo::DataBlock outDataBlock;
+        ASSERT_NO_THROW(outDataBlock = fifo.ReadBlock(blockSize));
+        EXPECT_EQ(outDataBlock.spans[1].data(), inDataBlock.spans[1].data());
+    }
+
+    ASSERT_NO_THROW(fifo.Reserve(fifo.maxSize));
+    EXPECT_EQ(fifo.CommitableSize(), 10);
+    EXPECT_THROW(fifo.Reserve(1), std::overflow_error);
+}
+
+// Test that block sequences count elements through the stream across wraparounds and reset to zero.
+TEST_F(FifoTest, Sequence)
+{
+    fifo.Reset();
+
+    uint64_t sequence = 0;
+    for (size_t blockSize = 1; blockSize < maxFifoSize; blockSize++)
+    {
+        SCOPED_TRACE(std::format("Sequence block loop iteration {}\r\n", blockSize));
+
+        NoCopyRingFifo<fifoDataType>::DataBlock inDataBlock;
+        ASSERT_NO_THROW(inDataBlock = fifo.Reserve(blockSize));
+        EXPECT_EQ(inDataBlock.sequence, sequence);
+        ASSERT_NO_THROW(fifo.Commit(blockSize));
+
+        NoCopyRingFifo<fifoDataType>::DataBlock outDataBlock;
+        ASSERT_NO_THROW(outDataBlock = fifo.PeekBlock(blockSize));
+        EXPECT_EQ(outDataBlock.sequence, sequence);
+        EXPECT_EQ(outDataBlock.spans[0].data(), inDataBlock.spans[0].data());
+        ASSERT_NO_THROW(fifo.Release(blockSize));
+
+        sequence += blockSize;
+    }
+
+    EXPECT_EQ(fifo.ReservableSize(), maxFifoSize);
+
+    fifo.Reset();
+    EXPECT_EQ(fifo.Reserve(1).sequence, 0);
+}
+
+// Test that contiguous reserves skip the end of the buffer instead of splitting, and that the skipped elements are
+// stepped over by commits and reads and reported in the statistics.
+TEST_F(FifoTest, ReserveContiguous)
+{
+    fifo.Reset();
+
+    ASSERT_NO_THROW(fifo.Reserve(7));
+    ASSERT_NO_THROW(fifo.Commit(7));
+    ASSERT_NO_THROW(fifo.ReadBlock(5));
+
+    // Three elements are left before the end of the buffer and five at the start.
+    EXPECT_EQ(fifo.ReservableSize(), 8);
+    EXPECT_EQ(fifo.ContiguousReservableSize(), 5);
+    EXPECT_THROW(fifo.ReserveContiguous(6), std::overflow_error);
+
+    auto reserveResult = fifo.TryReserveContiguous(6);
+    ASSERT_FALSE(reserveResult.has_value());
+    EXPECT_EQ(reserveResult.error(), FifoError::InsufficientSpace);
+
+    // A block that fits before the end of the buffer does not skip.
+    NoCopyRingFifo<fifoDataType>::DataBlock inDataBlock;
+    ASSERT_NO_THROW(inDataBlock = fifo.ReserveContiguous(2));
+    EXPECT_EQ(inDataBlock.isSplit(), false);
+    ASSERT_NO_THROW(fifo.Unreserve(2));
+    EXPECT_EQ(fifo.Statistics().skips, 0);
+
+    ASSERT_NO_THROW(inDataBlock = fifo.ReserveContiguous(4));
+    EXPECT_EQ(inDataBlock.isSplit(), false);
+    EXPECT_EQ(inDataBlock.spans[0].size(), 4);
+    EXPECT_EQ(fifo.Statistics().skips, 1);
+    EXPECT_EQ(fifo.Statistics().skippedElements, 3);
+
+    // The skipped elements are not reservable until they are released, but are not counted as reserved or readable.
+    EXPECT_EQ(fifo.ReservableSize(), 1);
+    EXPECT_EQ(fifo.CommitableSize(), 4);
+    EXPECT_EQ(fifo.ReadableSize(), 2);
+
+    ASSERT_NO_THROW(fifo.Commit(4));
+    EXPECT_EQ(fifo.ReadableSize(), 6);
+
+    // A read across the skipped elements continues at the start of the buffer.
+    NoCopyRingFifo<fifoDataType>::DataBlock outDataBlock;
+    ASSERT_NO_THROW(outDataBlock = fifo.ReadBlock(6));
+    EXPECT_EQ(outDataBlock.spans[0].size(), 2);
+    EXPECT_EQ(outDataBlock.spans[1].data(), inDataBlock.spans[0].data());
+    EXPECT_EQ(outDataBlock.spans[1].size(), 4);
+    EXPECT_EQ(fifo.ReservableSize(), maxFifoSize);
+}
+
+// Test that unreserving a contiguous block hands back the elements it skipped.
+TEST_F(FifoTest, ReserveContiguousUnreserve)
+{
+    fifo.Reset();
+
+    ASSERT_NO_THROW(fifo.Reserve(7));
+    ASSERT_NO_THROW(fifo.Commit(5));
+    ASSERT_NO_THROW(fifo.ReadBlock(5));
+
+    ASSERT_NO_THROW(fifo.ReserveContiguous(4));
+    EXPECT_EQ(fifo.CommitableSize(), 6);
+    EXPECT_EQ(fifo.ReservableSize(), 1);
+
+    ASSERT_NO_THROW(fifo.Unreserve(4));
+    EXPECT_EQ(fifo.CommitableSize(), 2);
+    EXPECT_EQ(fifo.ReservableSize(), 8);
+
+    // The next reserve carries on from the end of the uncommitted block, splitting as usual.
+    NoCopyRingFifo<fifoDataType>::DataBlock inDataBlock;
+    ASSERT_NO_THROW(inDataBlock = fifo.Reserve(4));
+    EXPECT_EQ(inDataBlock.spans[0].size(), 3);
+    EXPECT_EQ(inDataBlock.spans[1].size(), 1);
+}
+
+// Test that up-to calls take what is available, optionally stopping at the end of the buffer or insisting on a
+// minimum size.
+TEST_F(FifoTest, UpTo)
+{
+    fifo.Reset();
+
+    ASSERT_NO_THROW(fifo.Reserve(7));
+    ASSERT_NO_THROW(fifo.Commit(7));
+    ASSERT_NO_THROW(fifo.ReadBlock(5));
+
+    // Eight elements are free, three before the end of the buffer.
+    NoCopyRingFifo<fifoDataType>::DataBlock inDataBlock;
+    ASSERT_NO_THROW(inDataBlock = fifo.ReserveUpTo(4, 0, UpTo::Contiguous));
+    EXPECT_EQ(inDataBlock.size(), 3);
+    EXPECT_EQ(inDataBlock.isSplit(), false);
+    ASSERT_NO_THROW(fifo.Unreserve(3));
+
+    EXPECT_THROW(fifo.ReserveUpTo(9, 9), std::overflow_error);
+    EXPECT_EQ(fifo.TryReserveUpTo(4, 4, UpTo::Contiguous).error(), FifoError::InsufficientSpace);
+
+    ASSERT_NO_THROW(inDataBlock = fifo.ReserveUpTo(SIZE_MAX));
+    EXPECT_EQ(inDataBlock.size(), 8);
+    EXPECT_EQ(inDataBlock.isSplit(), true);
+    EXPECT_EQ(fifo.CommitableSize(), 8);
+    ASSERT_NO_THROW(fifo.Commit(8));
+
+    // A full FIFO returns an empty block unless a minimum is given.
+    ASSERT_NO_THROW(inDataBlock = fifo.ReserveUpTo(1));
+    EXPECT_EQ(inDataBlock.isValid(), false);
+    EXPECT_EQ(fifo.CommitableSize(), 0);
+
+    // Reads stop at the end of the buffer in the same way.
+    NoCopyRingFifo<fifoDataType>::DataBlock outDataBlock;
+    ASSERT_NO_THROW(outDataBlock = fifo.PeekUpTo(SIZE_MAX, 0, UpTo::Contiguous));
+    EXPECT_EQ(outDataBlock.size(), 5);
+    ASSERT_NO_THROW(fifo.Release(5));
+
+    EXPECT_THROW(fifo.ReadUpTo(10, 6), std::underflow_error);
+    EXPECT_EQ(fifo.TryPeekUpTo(10, 6).error(), FifoError::InsufficientData);
+
+    ASSERT_NO_THROW(outDataBlock = fifo.ReadUpTo(4, 2));
+    EXPECT_EQ(outDataBlock.size(), 4);
+    ASSERT_NO_THROW(outDataBlock = fifo.ReadUpTo(SIZE_MAX));
+    EXPECT_EQ(outDataBlock.size(), 1);
+    ASSERT_NO_THROW(outDataBlock = fifo.ReadUpTo(SIZE_MAX));
+    EXPECT_EQ(outDataBlock.isValid(), false);
+    EXPECT_EQ(fifo.ReservableSize(), maxFifoSize);
+}
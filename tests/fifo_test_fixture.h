@@ -3,6 +3,7 @@
 #include <gtest/gtest.h>
 
 #include "no_copy_ring_fifo.h"
+#include "mpsc_no_copy_ring_fifo.h"
 
 typedef uint32_t fifoDataType;
 
@@ -17,4 +18,18 @@ protected:
 
     static constexpr size_t maxFifoSize = 10;
     FifoTemplates::NoCopyRingFifo<fifoDataType> fifo = FifoTemplates::NoCopyRingFifo<fifoDataType>(maxFifoSize);
+};
+
+class SpscFifoTest : public testing::Test
+{
+protected:
+    static constexpr size_t maxFifoSize = 10;
+    FifoTemplates::SpscNoCopyRingFifo<fifoDataType> fifo = FifoTemplates::SpscNoCopyRingFifo<fifoDataType>(maxFifoSize);
+};
+
+class MpscFifoTest : public testing::Test
+{
+protected:
+    static constexpr size_t maxFifoSize = 10;
+    FifoTemplates::MpscNoCopyRingFifo<fifoDataType> fifo = FifoTemplates::MpscNoCopyRingFifo<fifoDataType>(maxFifoSize);
 };
\ No newline at end of file
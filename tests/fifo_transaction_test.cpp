@@ -0,0 +1,148 @@
+#include <stdexcept>
+
+#include <gtest/gtest.h>
+
+#include "fifo_test_fixture.h"
+#include "fifo_transaction.h"
+
+using namespace FifoTemplates;
+
+typedef NoCopyRingFifo<fifoDataType> Fifo;
+
+// Test that a write transaction hands its block back unless it is committed.
+TEST_F(FifoTest, WriteTransaction)
+{
+    fifo.Reset();
+
+    {
+        auto transaction = ReserveTransaction(fifo, 6);
+        EXPECT_TRUE(transaction.IsOpen());
+        EXPECT_EQ(transaction.Block().size(), 6);
+        EXPECT_EQ(fifo.CommitableSize(), 6);
+    }
+
+    EXPECT_EQ(fifo.CommitableSize(), 0);
+    EXPECT_EQ(fifo.ReservableSize(), maxFifoSize);
+
+    // An exception before the commit rolls the reservation back.
+    EXPECT_THROW(
+        {
+            auto transaction = ReserveTransaction(fifo, 6);
+            throw std::runtime_error("Failed to fill block");
+        },
+        std::runtime_error);
+    EXPECT_EQ(fifo.ReservableSize(), maxFifoSize);
+
+    // A partial commit hands back the rest of the block.
+    auto transaction = ReserveTransaction(fifo, 6);
+    transaction.Block().spans[0][0] = 42;
+    transaction.Commit(4);
+    EXPECT_FALSE(transaction.IsOpen());
+    EXPECT_EQ(fifo.ReadableSize(), 4);
+    EXPECT_EQ(fifo.CommitableSize(), 0);
+
+    // Moving the transaction moves the reservation with it.
+    WriteTransaction<Fifo> movedTransaction;
+    {
+        auto scopedTransaction = ReserveTransaction(fifo, 2);
+        movedTransaction = std::move(scopedTransaction);
+        EXPECT_FALSE(scopedTransaction.IsOpen());
+    }
+
+    EXPECT_EQ(fifo.CommitableSize(), 2);
+    movedTransaction.Commit();
+    EXPECT_EQ(fifo.ReadableSize(), 6);
+    EXPECT_EQ(fifo.ReadBlock(1).spans[0][0], 42);
+}
+
+// Test that a read transaction releases its block unless it is rolled back.
+TEST_F(FifoTest, ReadTransaction)
+{
+    fifo.Reset();
+
+    ASSERT_NO_THROW(fifo.Commit(fifo.Reserve(8).size()));
+
+    {
+        auto transaction = PeekTransaction(fifo, 3);
+        EXPECT_EQ(transaction.Block().sequence, 0);
+        EXPECT_EQ(fifo.ReleasableSize(), 3);
+        EXPECT_EQ(fifo.ReservableSize(), 2);
+    }
+
+    EXPECT_EQ(fifo.ReleasableSize(), 0);
+    EXPECT_EQ(fifo.ReservableSize(), 5);
+
+    {
+        auto transaction = PeekTransaction(fifo, 3);
+        transaction.Rollback();
+    }
+
+    EXPECT_EQ(fifo.ReadableSize(), 5);
+
+    // A partial release hands back the rest of the block to be read again.
+    ReadTransaction<Fifo> transaction(fifo, fifo.PeekUpTo(SIZE_MAX));
+    EXPECT_EQ(transaction.Block().size(), 5);
+    transaction.Release(2);
+    EXPECT_EQ(fifo.ReadableSize(), 3);
+    EXPECT_EQ(fifo.PeekBlock(1).sequence, 5);
+}
+
+// Test that nested transactions each act on their own block, in FIFO order.
+TEST_F(FifoTest, NestedTransactions)
+{
+    fifo.Reset();
+
+    // Scoped transactions finish newest first, so both blocks are handed back.
+    {
+        auto outerTransaction = ReserveTransaction(fifo, 2);
+        auto innerTransaction = ReserveTransaction(fifo, 3);
+        EXPECT_EQ(fifo.CommitableSize(), 5);
+    }
+
+    EXPECT_EQ(fifo.CommitableSize(), 0);
+    EXPECT_EQ(fifo.ReservableSize(), maxFifoSize);
+
+    auto firstTransaction = ReserveTransaction(fifo, 2);
+    auto secondTransaction = ReserveTransaction(fifo, 3);
+    firstTransaction.Block().spans[0][0] = 1;
+    secondTransaction.Block().spans[0][0] = 2;
+
+    // The second block cannot be committed ahead of the first, and the first cannot hand space back from under the
+    // second.  Both stay open.
+    EXPECT_THROW(secondTransaction.Commit(), std::overflow_error);
+    EXPECT_THROW(firstTransaction.Commit(1), std::overflow_error);
+    EXPECT_THROW(firstTransaction.Rollback(), std::overflow_error);
+    EXPECT_TRUE(firstTransaction.IsOpen());
+    EXPECT_TRUE(secondTransaction.IsOpen());
+    EXPECT_EQ(fifo.ReadableSize(), 0);
+
+    // Committed in order, each publishes its own data.
+    firstTransaction.Commit();
+    EXPECT_EQ(fifo.ReadableSize(), 2);
+    secondTransaction.Commit(1);
+    EXPECT_EQ(fifo.ReadableSize(), 3);
+    EXPECT_EQ(fifo.CommitableSize(), 0);
+
+    auto firstReadTransaction = PeekTransaction(fifo, 2);
+    auto secondReadTransaction = PeekTransaction(fifo, 1);
+    EXPECT_EQ(firstReadTransaction.Block().spans[0][0], 1);
+    EXPECT_EQ(secondReadTransaction.Block().spans[0][0], 2);
+    EXPECT_THROW(secondReadTransaction.Release(), std::underflow_error);
+    EXPECT_THROW(firstReadTransaction.Rollback(), std::underflow_error);
+    firstReadTransaction.Release();
+    EXPECT_EQ(fifo.ReleasableSize(), 1);
+    secondReadTransaction.Rollback();
+    EXPECT_EQ(fifo.ReleasableSize(), 0);
+    EXPECT_EQ(fifo.ReadableSize(), 1);
+
+    // Scoped read transactions also finish newest first.  The newest cannot be released ahead of the oldest, so it is
+    // handed back to be read again, and the oldest is released.
+    {
+        ASSERT_NO_THROW(fifo.Commit(fifo.Reserve(1).size()));
+        auto outerTransaction = PeekTransaction(fifo, 1);
+        auto innerTransaction = PeekTransaction(fifo, 1);
+    }
+
+    EXPECT_EQ(fifo.ReleasableSize(), 0);
+    EXPECT_EQ(fifo.ReadableSize(), 1);
+}
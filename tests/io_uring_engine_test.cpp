@@ -0,0 +1,256 @@
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "io_uring_engine.h"
+#include "mirrored_storage.h"
+
+using namespace FifoTemplates;
+
+typedef NoCopyRingFifo<uint8_t> ByteFifo;
+typedef NoCopyRingFifo<uint8_t, MirroredStorage<uint8_t>> MirroredByteFifo;
+
+namespace
+{
+    // Make an engine, or return null if io_uring is not available here.
+    template <typename Fifo> std::unique_ptr<IoUringEngine<Fifo>> MakeEngine(Fifo& fifo)
+    {
+        try
+        {
+            return std::make_unique<IoUringEngine<Fifo>>(fifo);
+        }
+        catch (const std::system_error&)
+        {
+            return nullptr;
+        }
+    }
+
+    // Copy from one descriptor to another through the FIFO until end of file, with a read and a write in flight
+    // together.  Explicit offsets are used unless the descriptors are streams.
+    template <typename Fifo>
+    void Pump(Fifo& fifo, IoUringEngine<Fifo>& engine, int inFd, int outFd, size_t readSize, bool useOffsets)
+    {
+        uint64_t readOffset = 0;
+        uint64_t writeOffset = 0;
+        bool endOfFile = false;
+
+        while (!endOfFile || (fifo.ReadableSize() != 0) || engine.ReadInFlight() || engine.WriteInFlight())
+        {
+            if (!endOfFile && !engine.ReadInFlight())
+            {
+                engine.StartRead(inFd, readSize, (useOffsets ? static_cast<int64_t>(readOffset) : -1));
+            }
+
+            if (!engine.WriteInFlight())
+            {
+                engine.StartWrite(outFd, SIZE_MAX, (useOffsets ? static_cast<int64_t>(writeOffset) : -1));
+            }
+
+            auto completions = engine.Complete(1);
+            ASSERT_TRUE(completions.has_value());
+
+            if (completions->read.has_value())
+            {
+                ASSERT_GE(*completions->read, 0);
+                endOfFile = (*completions->read == 0);
+                readOffset += *completions->read;
+            }
+
+            if (completions->write.has_value())
+            {
+                ASSERT_GT(*completions->write, 0);
+                writeOffset += *completions->write;
+            }
+        }
+
+        EXPECT_EQ(readOffset, writeOffset);
+        EXPECT_EQ(fifo.ReservableSize(), fifo.maxSize);
+    }
+
+    std::vector<uint8_t> MakeData(size_t size)
+    {
+        std::vector<uint8_t> data(size);
+        std::iota(data.begin(), data.end(), 0);
+        for (size_t i = 0; i < size; i++)
+        {
+            data[i] ^= static_cast<uint8_t>(i >> 8);
+        }
+
+        return data;
+    }
+}
+
+// Copy one regular file to another at explicit offsets, wrapping the FIFO buffer many times.
+TEST(IoUringEngineTest, FileCopy)
+{
+    ByteFifo fifo(1000);
+    auto engine = MakeEngine(fifo);
+    if (engine == nullptr)
+    {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+
+    const std::vector<uint8_t> data = MakeData(50000);
+
+    const int inFd = memfd_create("IoUringEngineIn", MFD_CLOEXEC);
+    const int outFd = memfd_create("IoUringEngineOut", MFD_CLOEXEC);
+    ASSERT_GE(inFd, 0);
+    ASSERT_GE(outFd, 0);
+    ASSERT_EQ(write(inFd, data.data(), data.size()), static_cast<ssize_t>(data.size()));
+
+    Pump(fifo, *engine, inFd, outFd, 300, true);
+
+    std::vector<uint8_t> copy(data.size() + 1);
+    ASSERT_EQ(pread(outFd, copy.data(), copy.size(), 0), static_cast<ssize_t>(data.size()));
+    copy.resize(data.size());
+    EXPECT_EQ(copy, data);
+
+    close(inFd);
+    close(outFd);
+}
+
+// Copy from a pipe fed by another thread into a file at its current position, through mirrored storage.  Pipe reads
+// come back short whenever the writer is behind.
+TEST(IoUringEngineTest, PipeCopy)
+{
+    MirroredByteFifo fifo(MirroredStorage<uint8_t>::RoundUpSize(4096));
+    auto engine = MakeEngine(fifo);
+    if (engine == nullptr)
+    {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+
+    const std::vector<uint8_t> data = MakeData(100000);
+
+    int pipeFds[2];
+    ASSERT_EQ(pipe(pipeFds), 0);
+    const int outFd = memfd_create("IoUringEngineOut", MFD_CLOEXEC);
+    ASSERT_GE(outFd, 0);
+
+    std::thread writer([&] {
+        for (size_t offset = 0; offset < data.size(); offset += 777)
+        {
+            const size_t size = std::min<size_t>(777, (data.size() - offset));
+            ASSERT_EQ(write(pipeFds[1], (data.data() + offset), size), static_cast<ssize_t>(size));
+        }
+
+        close(pipeFds[1]);
+    });
+
+    Pump(fifo, *engine, pipeFds[0], outFd, SIZE_MAX, false);
+    writer.join();
+
+    std::vector<uint8_t> copy(data.size() + 1);
+    ASSERT_EQ(pread(outFd, copy.data(), copy.size(), 0), static_cast<ssize_t>(data.size()));
+    copy.resize(data.size());
+    EXPECT_EQ(copy, data);
+
+    close(pipeFds[0]);
+    close(outFd);
+}
+
+// A failed request hands its whole block back, only one read and one write are in flight at a time, and neither starts
+// while the caller has a block open on its side.
+TEST(IoUringEngineTest, Errors)
+{
+    ByteFifo fifo(100);
+    auto engine = MakeEngine(fifo);
+    if (engine == nullptr)
+    {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+
+    EXPECT_FALSE(engine->StartWrite(-1));
+
+    ASSERT_TRUE(engine->StartRead(-1, 40));
+    EXPECT_FALSE(engine->StartRead(-1));
+    EXPECT_EQ(fifo.CommitableSize(), 40);
+
+    auto completions = engine->Complete(1);
+    ASSERT_TRUE(completions.has_value());
+    ASSERT_TRUE(completions->read.has_value());
+    EXPECT_EQ(*completions->read, -EBADF);
+    EXPECT_FALSE(completions->write.has_value());
+    EXPECT_FALSE(engine->ReadInFlight());
+    EXPECT_EQ(fifo.ReservableSize(), 100);
+
+    fifo.Reserve(30);
+    fifo.Commit(30);
+    ASSERT_TRUE(engine->StartWrite(-1));
+    EXPECT_EQ(fifo.ReleasableSize(), 30);
+    completions = engine->Complete(1);
+    ASSERT_TRUE(completions.has_value());
+    ASSERT_TRUE(completions->write.has_value());
+    EXPECT_EQ(*completions->write, -EBADF);
+    EXPECT_EQ(fifo.ReadableSize(), 30);
+    EXPECT_EQ(fifo.ReleasableSize(), 0);
+
+    // Nothing in flight, so there is nothing to wait for.
+    completions = engine->Complete(1);
+    ASSERT_TRUE(completions.has_value());
+    EXPECT_FALSE(completions->read.has_value());
+    EXPECT_FALSE(completions->write.has_value());
+
+    // The engine's block must be the only one open on its side.
+    auto reserved = fifo.Reserve(10);
+    EXPECT_FALSE(engine->StartRead(-1));
+    fifo.CommitAndUnreserve(reserved, 0);
+    auto peeked = fifo.PeekBlock(10);
+    EXPECT_FALSE(engine->StartWrite(-1));
+    fifo.ReleaseAndUnpeek(peeked, 0);
+    EXPECT_FALSE(engine->ReadInFlight());
+    EXPECT_FALSE(engine->WriteInFlight());
+}
+
+// Destroying the engine cancels the requests still in flight and hands their blocks back.
+TEST(IoUringEngineTest, CancelInFlight)
+{
+    ByteFifo fifo(100);
+    auto engine = MakeEngine(fifo);
+    if (engine == nullptr)
+    {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+
+    // A read from an empty pipe and a write to a full one both wait in the kernel.
+    int readPipeFds[2];
+    int writePipeFds[2];
+    ASSERT_EQ(pipe(readPipeFds), 0);
+    ASSERT_EQ(pipe2(writePipeFds, O_NONBLOCK), 0);
+    std::vector<uint8_t> filler(4096);
+    while (write(writePipeFds[1], filler.data(), filler.size()) > 0)
+    {
+    }
+
+    fifo.Reserve(30);
+    fifo.Commit(30);
+    ASSERT_TRUE(engine->StartRead(readPipeFds[0], 40));
+    ASSERT_TRUE(engine->StartWrite(writePipeFds[1]));
+    auto completions = engine->Complete();
+    ASSERT_TRUE(completions.has_value());
+    EXPECT_TRUE(engine->ReadInFlight());
+    EXPECT_TRUE(engine->WriteInFlight());
+    EXPECT_EQ(fifo.CommitableSize(), 40);
+    EXPECT_EQ(fifo.ReleasableSize(), 30);
+
+    engine.reset();
+
+    EXPECT_EQ(fifo.CommitableSize(), 0);
+    EXPECT_EQ(fifo.ReleasableSize(), 0);
+    EXPECT_EQ(fifo.ReadableSize(), 30);
+    EXPECT_EQ(fifo.ReservableSize(), 70);
+
+    for (int fd : { readPipeFds[0], readPipeFds[1], writePipeFds[0], writePipeFds[1] })
+    {
+        close(fd);
+    }
+}
@@ -0,0 +1,65 @@
+#include <format>
+
+#include <gtest/gtest.h>
+
+#include "fifo_test_fixture.h"
+#include "mirrored_storage.h"
+
+using namespace FifoTemplates;
+
+typedef NoCopyRingFifo<fifoDataType, MirroredStorage<fifoDataType>> MirroredFifo;
+
+// Test that the FIFO size must fill whole pages.
+TEST(MirroredStorageTest, Size)
+{
+    const size_t mirroredSize = MirroredStorage<fifoDataType>::RoundUpSize(1);
+    EXPECT_GT(mirroredSize, 1);
+    EXPECT_EQ(MirroredStorage<fifoDataType>::RoundUpSize(mirroredSize), mirroredSize);
+    EXPECT_EQ(MirroredStorage<fifoDataType>::RoundUpSize(mirroredSize + 1), (2 * mirroredSize));
+
+    EXPECT_THROW(MirroredFifo(mirroredSize - 1), std::invalid_argument);
+    EXPECT_NO_THROW(MirroredFifo fifo(mirroredSize));
+}
+
+// Test that blocks wrapping around the end of the buffer are returned as one span that aliases the start.
+TEST(MirroredStorageTest, Wraparound)
+{
+    const size_t fifoSize = MirroredStorage<fifoDataType>::RoundUpSize(1);
+    MirroredFifo fifo(fifoSize);
+
+    for (size_t blockSize = 2; blockSize < fifoSize; blockSize += (fifoSize / 7))
+    {
+        SCOPED_TRACE(std::format("Wraparound block loop iteration {}\r\n", blockSize));
+
+        fifo.Reset();
+
+        // Reserve, commit and read one less than the buffer size.
+        ASSERT_NO_THROW(fifo.Reserve(fifoSize - 1));
+        ASSERT_NO_THROW(fifo.Commit(fifoSize - 1));
+        ASSERT_NO_THROW(fifo.ReadBlock(fifoSize - 1));
+
+        // Reserve a block that wraps, it should still be one span.
+        MirroredFifo::DataBlock inDataBlock;
+        ASSERT_NO_THROW(inDataBlock = fifo.Reserve(blockSize));
+        EXPECT_EQ(inDataBlock.spans[0].size(), blockSize);
+        EXPECT_EQ(inDataBlock.isValid(), true);
+        EXPECT_EQ(inDataBlock.isSplit(), false);
+
+        for (size_t i = 0; i < blockSize; i++)
+        {
+            inDataBlock.spans[0][i] = static_cast<fifoDataType>(i + blockSize);
+        }
+
+        ASSERT_NO_THROW(fifo.Commit(blockSize));
+
+        // Read the block back, it should be the same single span.
+        MirroredFifo::DataBlock outDataBlock;
+        ASSERT_NO_THROW(outDataBlock = fifo.ReadBlock(blockSize));
+        EXPECT_EQ(outDataBlock.spans[0].data(), inDataBlock.spans[0].data());
+        EXPECT_EQ(outDataBlock.isSplit(), false);
+
+        // The elements past the end of the buffer alias the start of the buffer.
+        EXPECT_EQ(outDataBlock.spans[0][1], *(outDataBlock.spans[0].data() + 1 - fifoSize));
+        EXPECT_EQ(outDataBlock.spans[0][blockSize - 1], (2 * blockSize - 1));
+    }
+}
@@ -0,0 +1,518 @@
+#include <algorithm>
+#include <atomic>
+#include <format>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "fifo_test_fixture.h"
+
+using namespace FifoTemplates;
+
+// Test that a block committed ahead of an earlier reservation only becomes readable once the earlier block commits.
+TEST_F(MpscFifoTest, OutOfOrderCommit)
+{
+    fifo.Reset();
+
+    MpscNoCopyRingFifo<fifoDataType>::DataBlock firstDataBlock;
+    MpscNoCopyRingFifo<fifoDataType>::DataBlock secondDataBlock;
+    MpscNoCopyRingFifo<fifoDataType>::DataBlock thirdDataBlock;
+    ASSERT_NO_THROW(firstDataBlock = fifo.Reserve(2));
+    ASSERT_NO_THROW(secondDataBlock = fifo.Reserve(3));
+    ASSERT_NO_THROW(thirdDataBlock = fifo.Reserve(4));
+    EXPECT_EQ(fifo.ReservableSize(), (maxFifoSize - 9));
+    EXPECT_EQ(fifo.CommitableSize(), 9);
+
+    secondDataBlock.spans[0][0] = 2;
+    thirdDataBlock.spans[0][0] = 3;
+    firstDataBlock.spans[0][0] = 1;
+
+    // Commit the later blocks first, nothing is readable yet.
+    ASSERT_NO_THROW(fifo.Commit(thirdDataBlock));
+    EXPECT_EQ(fifo.ReadableSize(), 0);
+    ASSERT_NO_THROW(fifo.Commit(secondDataBlock));
+    EXPECT_EQ(fifo.ReadableSize(), 0);
+
+    // Committing the first block releases all three.
+    ASSERT_NO_THROW(fifo.Commit(firstDataBlock));
+    EXPECT_EQ(fifo.ReadableSize(), 9);
+    EXPECT_EQ(fifo.CommitableSize(), 0);
+
+    // Committing a block twice is an error.
+    EXPECT_THROW(fifo.Commit(firstDataBlock), std::overflow_error);
+
+    MpscNoCopyRingFifo<fifoDataType>::DataBlock outDataBlock;
+    ASSERT_NO_THROW(outDataBlock = fifo.ReadBlock(9));
+    EXPECT_EQ(outDataBlock.spans[0][0], 1);
+    EXPECT_EQ(outDataBlock.spans[0][2], 2);
+    EXPECT_EQ(outDataBlock.spans[0][5], 3);
+}
+
+// Test FIFO buffer wraparound with out of order commits.
+TEST_F(MpscFifoTest, Wraparound)
+{
+    for (size_t blockSize = 2; blockSize < maxFifoSize; blockSize++)
+    {
+        SCOPED_TRACE(std::format("Wraparound block loop iteration {}\r\n", blockSize));
+
+        fifo.Reset();
+
+        // Leave the cursors one element before the end of the buffer.
+        ASSERT_NO_THROW(fifo.Commit(fifo.Reserve(maxFifoSize - 1)));
+        ASSERT_NO_THROW(fifo.ReadBlock(maxFifoSize - 1));
+
+        MpscNoCopyRingFifo<fifoDataType>::DataBlock wrappedDataBlock;
+        ASSERT_NO_THROW(wrappedDataBlock = fifo.Reserve(blockSize - 1));
+        EXPECT_EQ(wrappedDataBlock.isSplit(), (blockSize > 2));
+
+        MpscNoCopyRingFifo<fifoDataType>::DataBlock lastDataBlock;
+        ASSERT_NO_THROW(lastDataBlock = fifo.Reserve(1));
+
+        ASSERT_NO_THROW(fifo.Commit(lastDataBlock));
+        EXPECT_EQ(fifo.ReadableSize(), 0);
+        ASSERT_NO_THROW(fifo.Commit(wrappedDataBlock));
+        EXPECT_EQ(fifo.ReadableSize(), blockSize);
+
+        ASSERT_NO_THROW(fifo.ReadBlock(blockSize));
+        EXPECT_EQ(fifo.ReservableSize(), maxFifoSize);
+    }
+}
+
+// Several producer threads each stream a counting sequence tagged with their id.  Each producer's values must reach
+// the consumer complete and in order.
+TEST_F(MpscFifoTest, ProducersConsumerThreads)
+{
+    constexpr int producerCount = 4;
+    constexpr fifoDataType valuesPerProducer = 20000;
+    constexpr fifoDataType producerShift = 24;
+
+    fifo.Reset();
+
+    std::vector<std::thread> producers;
+    for (fifoDataType producerId = 0; producerId < producerCount; producerId++)
+    {
+        producers.emplace_back([&, producerId]()
+            {
+                for (fifoDataType value = 0; value < valuesPerProducer; value++)
+                {
+                    auto dataBlock = fifo.TryReserve(1);
+                    while (!dataBlock)
+                    {
+                        std::this_thread::yield();
+                        dataBlock = fifo.TryReserve(1);
+                    }
+
+                    dataBlock->spans[0][0] = ((producerId << producerShift) | value);
+                    fifo.Commit(*dataBlock);
+                }
+            });
+    }
+
+    std::vector<fifoDataType> nextValues(producerCount, 0);
+    bool inOrder = true;
+    for (size_t received = 0; received < (producerCount * valuesPerProducer);)
+    {
+        const size_t readable = fifo.ReadableSize();
+        if (readable == 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        auto dataBlock = fifo.PeekBlock(readable);
+        for (auto& span : dataBlock.spans)
+        {
+            for (auto& element : span)
+            {
+                const fifoDataType producerId = (element >> producerShift);
+                const fifoDataType value = (element & ((1 << producerShift) - 1));
+                inOrder = inOrder && (producerId < producerCount) && (value == nextValues[producerId]++);
+            }
+        }
+        fifo.Release(readable);
+        received += readable;
+    }
+
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+
+    EXPECT_TRUE(inOrder);
+    EXPECT_EQ(fifo.ReservableSize(), maxFifoSize);
+}
+
+// Test that space is only reclaimed past a contiguous run of released blocks.
+TEST_F(MpscFifoTest, OutOfOrderRelease)
+{
+    fifo.Reset();
+
+    ASSERT_NO_THROW(fifo.Commit(fifo.Reserve(maxFifoSize)));
+
+    MpscNoCopyRingFifo<fifoDataType>::DataBlock firstDataBlock;
+    MpscNoCopyRingFifo<fifoDataType>::DataBlock secondDataBlock;
+    MpscNoCopyRingFifo<fifoDataType>::DataBlock thirdDataBlock;
+    ASSERT_NO_THROW(firstDataBlock = fifo.PeekBlock(2));
+    ASSERT_NO_THROW(secondDataBlock = fifo.PeekBlock(3));
+    ASSERT_NO_THROW(thirdDataBlock = fifo.PeekBlock(4));
+    EXPECT_EQ(fifo.ReleasableSize(), 9);
+
+    // Release the later blocks first, no space is reclaimed yet.
+    ASSERT_NO_THROW(fifo.Release(secondDataBlock));
+    ASSERT_NO_THROW(fifo.Release(thirdDataBlock));
+    EXPECT_EQ(fifo.ReservableSize(), 0);
+
+    // Releasing the first block reclaims all three.
+    ASSERT_NO_THROW(fifo.Release(firstDataBlock));
+    EXPECT_EQ(fifo.ReservableSize(), 9);
+    EXPECT_EQ(fifo.ReleasableSize(), 0);
+
+    // Releasing a block twice, or a block that has not been peeked, is an error.
+    EXPECT_THROW(fifo.Release(firstDataBlock), std::underflow_error);
+
+    MpscNoCopyRingFifo<fifoDataType>::DataBlock unpeekedDataBlock;
+    ASSERT_NO_THROW(unpeekedDataBlock = fifo.Reserve(1));
+    EXPECT_FALSE(fifo.TryRelease(unpeekedDataBlock).has_value());
+}
+
+// A consumer peeks consecutive blocks and hands them to worker threads, which release them in whatever order they
+// finish.  Every element must be reclaimed once all workers are done.
+TEST_F(MpscFifoTest, ReleaseThreads)
+{
+    constexpr int workerCount = 3;
+    constexpr size_t blockCount = 20000;
+
+    fifo.Reset();
+
+    std::vector<MpscNoCopyRingFifo<fifoDataType>::DataBlock> workerBlocks[workerCount];
+    for (auto& blocks : workerBlocks)
+    {
+        blocks.reserve(blockCount);
+    }
+
+    std::atomic<size_t> published[workerCount] = {};
+    std::atomic<bool> done = false;
+    std::vector<std::thread> workers;
+    for (int worker = 0; worker < workerCount; worker++)
+    {
+        workers.emplace_back([&, worker]()
+            {
+                size_t next = 0;
+                while (!done.load() || (next < published[worker].load()))
+                {
+                    if (next == published[worker].load(std::memory_order_acquire))
+                    {
+                        std::this_thread::yield();
+                        continue;
+                    }
+
+                    fifo.Release(workerBlocks[worker][next++]);
+                }
+            });
+    }
+
+    for (size_t block = 0; block < blockCount; block++)
+    {
+        const size_t blockSize = ((block % 3) + 1);
+
+        auto inDataBlock = fifo.TryReserve(blockSize);
+        while (!inDataBlock)
+        {
+            std::this_thread::yield();
+            inDataBlock = fifo.TryReserve(blockSize);
+        }
+        fifo.Commit(*inDataBlock);
+
+        const int worker = static_cast<int>(block % workerCount);
+        workerBlocks[worker].push_back(fifo.PeekBlock(blockSize));
+        published[worker].fetch_add(1, std::memory_order_release);
+    }
+
+    done = true;
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    EXPECT_EQ(fifo.ReleasableSize(), 0);
+    EXPECT_EQ(fifo.ReservableSize(), maxFifoSize);
+}
+
+// Stream values from several producers using only the blocking calls, so producers contend for freed space.
+TEST_F(MpscFifoTest, BlockingThreads)
+{
+    using namespace std::chrono_literals;
+
+    constexpr int producerCount = 4;
+    constexpr fifoDataType valuesPerProducer = 20000;
+    constexpr fifoDataType producerShift = 24;
+
+    fifo.Reset();
+
+    EXPECT_EQ(fifo.TryReadBlock(1, 1ms).error(), FifoError::InsufficientData);
+
+    std::vector<std::thread> producers;
+    for (fifoDataType producerId = 0; producerId < producerCount; producerId++)
+    {
+        producers.emplace_back([&, producerId]()
+            {
+                for (fifoDataType value = 0; value < valuesPerProducer; value++)
+                {
+                    auto dataBlock = fifo.Reserve(1, waitForever);
+                    dataBlock.spans[0][0] = ((producerId << producerShift) | value);
+                    fifo.Commit(dataBlock);
+                }
+            });
+    }
+
+    std::vector<fifoDataType> nextValues(producerCount, 0);
+    bool inOrder = true;
+    for (size_t received = 0; received < (producerCount * valuesPerProducer); received++)
+    {
+        auto dataBlock = fifo.PeekBlock(1, waitForever);
+        const fifoDataType element = dataBlock.spans[0][0];
+        const fifoDataType producerId = (element >> producerShift);
+        const fifoDataType value = (element & ((1 << producerShift) - 1));
+        inOrder = inOrder && (producerId < producerCount) && (value == nextValues[producerId]++);
+        fifo.Release(dataBlock);
+    }
+
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+
+    EXPECT_TRUE(inOrder);
+    EXPECT_EQ(fifo.TryReserve(maxFifoSize + 1, waitForever).error(), FifoError::InsufficientSpace);
+    EXPECT_EQ(fifo.ReservableSize(), maxFifoSize);
+}
+
+// Test that up-to reserves from several producers never claim the same space, with the consumer reading up to
+// whatever is committed.
+TEST_F(MpscFifoTest, UpToThreads)
+{
+    constexpr int producerCount = 4;
+    constexpr fifoDataType valuesPerProducer = 20000;
+    constexpr fifoDataType producerShift = 24;
+
+    fifo.Reset();
+
+    std::vector<std::thread> producers;
+    for (fifoDataType producerId = 0; producerId < producerCount; producerId++)
+    {
+        producers.emplace_back([&, producerId]()
+            {
+                for (fifoDataType value = 0; value < valuesPerProducer;)
+                {
+                    const size_t size = std::min<size_t>(3, (valuesPerProducer - value));
+
+                    auto dataBlock = fifo.TryReserveUpTo(size, 1, UpTo::Contiguous);
+                    while (!dataBlock)
+                    {
+                        std::this_thread::yield();
+                        dataBlock = fifo.TryReserveUpTo(size, 1, UpTo::Contiguous);
+                    }
+
+                    for (auto& element : dataBlock->spans[0])
+                    {
+                        element = ((producerId << producerShift) | value++);
+                    }
+                    fifo.Commit(*dataBlock);
+                }
+            });
+    }
+
+    std::vector<fifoDataType> nextValues(producerCount, 0);
+    bool inOrder = true;
+    for (size_t received = 0; received < (producerCount * valuesPerProducer);)
+    {
+        auto dataBlock = fifo.PeekUpTo(SIZE_MAX);
+        if (!dataBlock.isValid())
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        for (auto& span : dataBlock.spans)
+        {
+            for (auto& element : span)
+            {
+                const fifoDataType producerId = (element >> producerShift);
+                const fifoDataType value = (element & ((1 << producerShift) - 1));
+                inOrder = inOrder && (producerId < producerCount) && (value == nextValues[producerId]++);
+            }
+        }
+        fifo.Release(dataBlock.size());
+        received += dataBlock.size();
+    }
+
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+
+    EXPECT_TRUE(inOrder);
+    EXPECT_EQ(fifo.ReservableSize(), maxFifoSize);
+    EXPECT_EQ(fifo.TryReadUpTo(1, 1).error(), FifoError::InsufficientData);
+}
+
+// Test that only the most recent reservation can be shrunk or handed back.
+TEST_F(MpscFifoTest, CommitAndUnreserve)
+{
+    fifo.Reset();
+
+    MpscNoCopyRingFifo<fifoDataType>::DataBlock firstDataBlock;
+    MpscNoCopyRingFifo<fifoDataType>::DataBlock secondDataBlock;
+    ASSERT_NO_THROW(firstDataBlock = fifo.Reserve(4));
+    ASSERT_NO_THROW(secondDataBlock = fifo.Reserve(4));
+
+    // The first block is no longer at the end of the reserved space, so only a whole commit works.
+    EXPECT_THROW(fifo.CommitAndUnreserve(firstDataBlock, 2), std::overflow_error);
+    EXPECT_THROW(fifo.Unreserve(firstDataBlock), std::overflow_error);
+
+    ASSERT_NO_THROW(fifo.CommitAndUnreserve(secondDataBlock, 1));
+    EXPECT_EQ(fifo.ReservableSize(), (maxFifoSize - 5));
+    EXPECT_EQ(fifo.ReadableSize(), 0);
+
+    ASSERT_NO_THROW(fifo.CommitAndUnreserve(firstDataBlock, 4));
+    EXPECT_EQ(fifo.ReadableSize(), 5);
+    EXPECT_EQ(fifo.CommitableSize(), 0);
+
+    // A reservation abandoned while it is the most recent one gives all of its space back.
+    ASSERT_NO_THROW(firstDataBlock = fifo.Reserve(3));
+    ASSERT_NO_THROW(fifo.Unreserve(firstDataBlock));
+    EXPECT_EQ(fifo.ReservableSize(), (maxFifoSize - 5));
+
+    MpscNoCopyRingFifo<fifoDataType>::DataBlock nextDataBlock;
+    ASSERT_NO_THROW(nextDataBlock = fifo.Reserve(1));
+    EXPECT_EQ(nextDataBlock.sequence, 5);
+
+    // A whole commit still checks the block, so one already committed ahead of an older block, or one past the
+    // reserved space, is refused.
+    ASSERT_NO_THROW(firstDataBlock = fifo.Reserve(2));
+    ASSERT_NO_THROW(fifo.Commit(firstDataBlock));
+    EXPECT_THROW(fifo.CommitAndUnreserve(firstDataBlock, firstDataBlock.size()), std::overflow_error);
+
+    MpscNoCopyRingFifo<fifoDataType>::DataBlock pastDataBlock = firstDataBlock;
+    pastDataBlock.sequence += 2;
+    EXPECT_THROW(fifo.CommitAndUnreserve(pastDataBlock, pastDataBlock.size()), std::overflow_error);
+
+    ASSERT_NO_THROW(fifo.CommitAndUnreserve(nextDataBlock, 1));
+    EXPECT_EQ(fifo.CommitableSize(), 0);
+    EXPECT_EQ(fifo.ReadableSize(), 8);
+}
+
+// Blocks completed ahead of an older one each take a slot, and a completion that finds every slot in use fails without
+// changing anything, so it can be retried once the older block has completed.
+TEST(MpscFifoSlotTest, OutOfOrderSlots)
+{
+    MpscNoCopyRingFifo<uint8_t> fifo(100, 2);
+
+    std::vector<MpscNoCopyRingFifo<uint8_t>::DataBlock> dataBlocks;
+    for (int block = 0; block < 4; block++)
+    {
+        dataBlocks.push_back(fifo.Reserve(10));
+    }
+
+    ASSERT_NO_THROW(fifo.Commit(dataBlocks[1]));
+    ASSERT_NO_THROW(fifo.Commit(dataBlocks[2]));
+    EXPECT_EQ(fifo.TryCommit(dataBlocks[3]).error(), FifoError::TooManyOutOfOrder);
+    EXPECT_THROW(fifo.Commit(dataBlocks[3]), std::overflow_error);
+    EXPECT_EQ(fifo.CommitableSize(), 40);
+
+    // A block that is already parked cannot be committed again.
+    EXPECT_EQ(fifo.TryCommit(dataBlocks[2]).error(), FifoError::InsufficientReserved);
+
+    ASSERT_NO_THROW(fifo.Commit(dataBlocks[0]));
+    EXPECT_EQ(fifo.ReadableSize(), 30);
+    ASSERT_NO_THROW(fifo.Commit(dataBlocks[3]));
+    EXPECT_EQ(fifo.ReadableSize(), 40);
+
+    // The read side works the same way, and a read behind outstanding peeks needs a slot too.
+    dataBlocks.clear();
+    for (int block = 0; block < 4; block++)
+    {
+        dataBlocks.push_back(fifo.PeekBlock(5));
+    }
+
+    ASSERT_NO_THROW(fifo.Release(dataBlocks[2]));
+    ASSERT_NO_THROW(fifo.Release(dataBlocks[3]));
+    EXPECT_EQ(fifo.TryRelease(dataBlocks[1]).error(), FifoError::TooManyOutOfOrder);
+    EXPECT_EQ(fifo.TryReadBlock(5).error(), FifoError::TooManyOutOfOrder);
+    EXPECT_EQ(fifo.ReadableSize(), 20);
+
+    ASSERT_NO_THROW(fifo.Release(dataBlocks[0]));
+    ASSERT_NO_THROW(fifo.Release(dataBlocks[1]));
+    EXPECT_EQ(fifo.ReleasableSize(), 0);
+    EXPECT_EQ(fifo.ReservableSize(), 80);
+}
+
+// Stream values from several producers through a FIFO with fewer slots than producers, so commits regularly find
+// every slot in use and have to be retried.
+TEST(MpscFifoSlotTest, SlotThreads)
+{
+    constexpr int producerCount = 4;
+    constexpr fifoDataType valuesPerProducer = 20000;
+    constexpr fifoDataType producerShift = 24;
+
+    MpscNoCopyRingFifo<fifoDataType> fifo(64, 2);
+
+    std::vector<std::thread> producers;
+    for (fifoDataType producerId = 0; producerId < producerCount; producerId++)
+    {
+        producers.emplace_back([&, producerId]()
+            {
+                for (fifoDataType value = 0; value < valuesPerProducer; value++)
+                {
+                    auto dataBlock = fifo.TryReserve(1);
+                    while (!dataBlock)
+                    {
+                        std::this_thread::yield();
+                        dataBlock = fifo.TryReserve(1);
+                    }
+
+                    dataBlock->spans[0][0] = ((producerId << producerShift) | value);
+                    auto committed = fifo.TryCommit(*dataBlock);
+                    while (!committed.has_value() && (committed.error() == FifoError::TooManyOutOfOrder))
+                    {
+                        std::this_thread::yield();
+                        committed = fifo.TryCommit(*dataBlock);
+                    }
+
+                    ASSERT_TRUE(committed.has_value());
+                }
+            });
+    }
+
+    std::vector<fifoDataType> nextValues(producerCount, 0);
+    bool inOrder = true;
+    for (size_t received = 0; received < (producerCount * valuesPerProducer);)
+    {
+        auto dataBlock = fifo.PeekUpTo(SIZE_MAX);
+        for (auto& span : dataBlock.spans)
+        {
+            for (auto& element : span)
+            {
+                const fifoDataType producerId = (element >> producerShift);
+                const fifoDataType value = (element & ((1 << producerShift) - 1));
+                inOrder = inOrder && (producerId < producerCount) && (value == nextValues[producerId]++);
+            }
+        }
+
+        fifo.Release(dataBlock.size());
+        received += dataBlock.size();
+        if (dataBlock.size() == 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+
+    EXPECT_TRUE(inOrder);
+    EXPECT_EQ(fifo.ReservableSize(), 64);
+}
@@ -0,0 +1,165 @@
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <stdexcept>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "record_fifo.h"
+
+using namespace FifoTemplates;
+
+typedef NoCopyRingFifo<std::byte> ByteFifo;
+typedef SpscNoCopyRingFifo<std::byte> SpscByteFifo;
+
+namespace
+{
+    std::byte RecordByte(size_t record, size_t index)
+    {
+        return static_cast<std::byte>((record * 31) + index);
+    }
+
+    void FillRecord(const ByteFifo::DataBlock& payload, size_t record)
+    {
+        size_t index = 0;
+        for (const auto& span : payload.spans)
+        {
+            for (auto& element : span)
+            {
+                element = RecordByte(record, index++);
+            }
+        }
+    }
+
+    bool CheckRecord(const ByteFifo::DataBlock& payload, size_t record)
+    {
+        size_t index = 0;
+        for (const auto& span : payload.spans)
+        {
+            for (const auto& element : span)
+            {
+                if (element != RecordByte(record, index++))
+                {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+}
+
+// Test the record space and the FIFO size check.
+TEST(RecordFifoTest, Space)
+{
+    EXPECT_EQ(RecordFifo<ByteFifo>::RecordSpace(0), 8);
+    EXPECT_EQ(RecordFifo<ByteFifo>::RecordSpace(1), 16);
+    EXPECT_EQ(RecordFifo<ByteFifo>::RecordSpace(8), 16);
+    EXPECT_EQ(RecordFifo<ByteFifo>::RecordSpace(9), 24);
+
+    ByteFifo badFifo(100);
+    EXPECT_THROW(RecordFifo<ByteFifo> records(badFifo), std::invalid_argument);
+
+    // Sizes whose rounding would overflow are refused rather than wrapping to a small reservation.
+    ByteFifo fifo(64);
+    RecordFifo<ByteFifo> records(fifo);
+    EXPECT_EQ(records.MaxRecordSize(), 56);
+    EXPECT_THROW(records.ReserveRecord(SIZE_MAX), std::overflow_error);
+    EXPECT_THROW(records.ReserveRecord(SIZE_MAX - 6), std::overflow_error);
+    EXPECT_EQ(records.TryReserveRecord(57).error(), FifoError::InsufficientSpace);
+    EXPECT_EQ(fifo.ReservableSize(), 64);
+    ASSERT_NO_THROW(records.ReserveRecord(56));
+    EXPECT_EQ(fifo.ReservableSize(), 0);
+}
+
+// Write and read records of every length up to 100, wrapping around the buffer, with two records in the FIFO at once.
+TEST(RecordFifoTest, Wraparound)
+{
+    ByteFifo fifo(256);
+    RecordFifo records(fifo);
+
+    auto empty = records.TryReadRecord();
+    ASSERT_FALSE(empty.has_value());
+    EXPECT_EQ(empty.error(), FifoError::InsufficientData);
+    EXPECT_THROW(records.ReadRecord(), std::underflow_error);
+
+    ASSERT_NO_THROW(FillRecord(records.ReserveRecord(0), 0));
+    records.CommitRecord(ByteFifo::DataBlock());
+
+    for (size_t length = 1; length <= 100; length++)
+    {
+        SCOPED_TRACE(std::format("Record length {}\r\n", length));
+
+        ByteFifo::DataBlock payload;
+        ASSERT_NO_THROW(payload = records.ReserveRecord(length));
+        ASSERT_EQ(payload.size(), length);
+        FillRecord(payload, length);
+
+        // Not visible until committed.
+        const size_t readable = fifo.ReadableSize();
+        records.CommitRecord(payload);
+        EXPECT_EQ(fifo.ReadableSize(), (readable + RecordFifo<ByteFifo>::RecordSpace(length)));
+
+        ByteFifo::DataBlock record;
+        ASSERT_NO_THROW(record = records.ReadRecord());
+        ASSERT_EQ(record.size(), (length - 1));
+        EXPECT_TRUE(CheckRecord(record, (length - 1)));
+        EXPECT_EQ(record.sequence, (payload.sequence - RecordFifo<ByteFifo>::RecordSpace(length - 1)));
+    }
+
+    auto last = records.TryPeekRecord();
+    ASSERT_TRUE(last.has_value());
+    EXPECT_TRUE(CheckRecord(*last, 100));
+    EXPECT_FALSE(records.TryPeekRecord().has_value());
+    records.ReleaseRecord(*last);
+    EXPECT_EQ(fifo.ReservableSize(), 256);
+
+    EXPECT_FALSE(records.TryReserveRecord(249).has_value());
+    EXPECT_TRUE(records.TryReserveRecord(248).has_value());
+}
+
+// Pass records between threads through an SPSC FIFO.
+TEST(RecordFifoTest, ProducerConsumerThreads)
+{
+    static constexpr size_t recordCount = 20000;
+
+    SpscByteFifo fifo(1024);
+    RecordFifo records(fifo);
+
+    std::thread producer([&] {
+        for (size_t record = 0; record < recordCount; record++)
+        {
+            const size_t length = ((record * 13) % 200);
+            std::expected<SpscByteFifo::DataBlock, FifoError> payload;
+            while (!(payload = records.TryReserveRecord(length)).has_value())
+            {
+                std::this_thread::yield();
+            }
+
+            FillRecord(*payload, record);
+            records.CommitRecord(*payload);
+        }
+    });
+
+    size_t errors = 0;
+    for (size_t record = 0; record < recordCount; record++)
+    {
+        std::expected<SpscByteFifo::DataBlock, FifoError> payload;
+        while (!(payload = records.TryPeekRecord()).has_value())
+        {
+            std::this_thread::yield();
+        }
+
+        if ((payload->size() != ((record * 13) % 200)) || !CheckRecord(*payload, record))
+        {
+            errors++;
+        }
+
+        records.ReleaseRecord(*payload);
+    }
+
+    producer.join();
+
+    EXPECT_EQ(errors, 0);
+}
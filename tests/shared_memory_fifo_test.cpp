@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <format>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "fifo_test_fixture.h"
+#include "shared_memory_fifo.h"
+
+using namespace FifoTemplates;
+
+typedef SharedMemoryNoCopyRingFifo<fifoDataType> SharedFifo;
+
+namespace
+{
+    std::string TestFifoName(void)
+    {
+        return std::format("/NoCopyRingFifoTest.{}", getpid());
+    }
+}
+
+// Test a producer and a consumer attached to the same named FIFO through two separate mappings.
+TEST(SharedMemoryFifoTest, CreateAttach)
+{
+    const std::string name = TestFifoName();
+    SharedFifo::Unlink(name);
+
+    SharedFifo producer = SharedFifo::Create(name, 10);
+    EXPECT_THROW(SharedFifo::Create(name, 10), std::system_error);
+
+    SharedFifo consumer = SharedFifo::Attach(name);
+    SharedFifo::Unlink(name);
+    EXPECT_EQ(consumer.maxSize, 10);
+
+    for (size_t blockSize = 1; blockSize < 10; blockSize++)
+    {
+        SCOPED_TRACE(std::format("Block loop iteration {}\r\n", blockSize));
+
+        SharedFifo::DataBlock inDataBlock;
+        ASSERT_NO_THROW(inDataBlock = producer.Reserve(blockSize));
+        inDataBlock.spans[0][0] = static_cast<fifoDataType>(blockSize);
+        ASSERT_NO_THROW(producer.Commit(blockSize));
+
+        EXPECT_EQ(consumer.ReadableSize(), blockSize);
+
+        SharedFifo::DataBlock outDataBlock;
+        ASSERT_NO_THROW(outDataBlock = consumer.PeekBlock(blockSize));
+        EXPECT_EQ(outDataBlock.sequence, inDataBlock.sequence);
+        EXPECT_EQ(outDataBlock.isSplit(), inDataBlock.isSplit());
+        EXPECT_NE(outDataBlock.spans[0].data(), inDataBlock.spans[0].data());
+        EXPECT_EQ(outDataBlock.spans[0][0], blockSize);
+        ASSERT_NO_THROW(consumer.Release(blockSize));
+    }
+
+    EXPECT_EQ(producer.ReservableSize(), 10);
+    EXPECT_THROW(consumer.ReadBlock(1), std::underflow_error);
+}
+
+// Test that attaching checks the header.
+TEST(SharedMemoryFifoTest, AttachChecks)
+{
+    SharedFifo fifo = SharedFifo::Create(10);
+
+    // Element size mismatch.
+    EXPECT_THROW(SharedMemoryNoCopyRingFifo<uint64_t>::Attach(fifo.Fd()), std::runtime_error);
+
+    // Memory that does not hold a FIFO.
+    const int fd = memfd_create("NoCopyRingFifoTest", 0);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(ftruncate(fd, 4096), 0);
+    EXPECT_THROW(SharedFifo::Attach(fd), std::runtime_error);
+
+    // A different layout version.
+    {
+        SharedFifo other = SharedFifo::Attach(fifo.Fd());
+        const uint32_t badVersion = (SharedFifoHeader::expectedVersion + 1);
+        ASSERT_EQ(pwrite(other.Fd(), &badVersion, sizeof(badVersion), offsetof(SharedFifoHeader, version)),
+            static_cast<ssize_t>(sizeof(badVersion)));
+    }
+    EXPECT_THROW(SharedFifo::Attach(fifo.Fd()), std::runtime_error);
+
+    close(fd);
+}
+
+// Stream a counting sequence from a forked producer process to the consumer in this process.
+TEST(SharedMemoryFifoTest, ProducerProcess)
+{
+    constexpr fifoDataType elementCount = 100000;
+
+    SharedFifo consumer = SharedFifo::Create(64);
+
+    const pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+
+    if (pid == 0)
+    {
+        SharedFifo producer = SharedFifo::Attach(consumer.Fd());
+
+        fifoDataType next = 0;
+        while (next < elementCount)
+        {
+            const size_t blockSize = std::min<size_t>({ producer.ReservableSize(), ((next % 7) + 1), (elementCount - next) });
+            if (blockSize == 0)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            auto dataBlock = producer.Reserve(blockSize);
+            for (auto& span : dataBlock.spans)
+            {
+                for (auto& element : span)
+                {
+                    element = next++;
+                }
+            }
+            producer.Commit(blockSize);
+        }
+
+        _exit(0);
+    }
+
+    fifoDataType expected = 0;
+    bool inOrder = true;
+    while (expected < elementCount)
+    {
+        const size_t readable = consumer.ReadableSize();
+        if (readable == 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        auto dataBlock = consumer.PeekBlock(readable);
+        for (auto& span : dataBlock.spans)
+        {
+            for (auto& element : span)
+            {
+                inOrder = inOrder && (element == expected);
+                expected++;
+            }
+        }
+        consumer.Release(readable);
+    }
+
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT_TRUE(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+    EXPECT_TRUE(inOrder);
+    EXPECT_EQ(consumer.ReleasableSize(), 0);
+}
+
+// Test that a producer that dies holding reservations can be replaced without losing committed data.
+TEST(SharedMemoryFifoTest, ProducerRecovery)
+{
+    SharedFifo consumer = SharedFifo::Create(10);
+    EXPECT_EQ(consumer.AcquireConsumer(), LeaseStatus::Acquired);
+    EXPECT_FALSE(consumer.ProducerAlive());
+
+    const pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+
+    if (pid == 0)
+    {
+        SharedFifo producer = SharedFifo::Attach(consumer.Fd());
+        if (producer.AcquireProducer() != LeaseStatus::Acquired)
+        {
+            _exit(1);
+        }
+
+        // Commit three elements and die holding a reservation of four more.
+        auto dataBlock = producer.Reserve(3);
+        for (fifoDataType i = 0; i < 3; i++)
+        {
+            dataBlock.spans[0][i] = i;
+        }
+        producer.Commit(3);
+        producer.Reserve(4);
+
+        _exit(0);
+    }
+
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+
+    EXPECT_EQ(consumer.ReadableSize(), 3);
+
+    SharedFifo producer = SharedFifo::Attach(consumer.Fd());
+    EXPECT_EQ(producer.AcquireProducer(), LeaseStatus::Recovered);
+    EXPECT_TRUE(consumer.ProducerAlive());
+    EXPECT_EQ(producer.ReservableSize(), 7);
+    EXPECT_EQ(producer.CommitableSize(), 0);
+
+    // The replacement producer carries on from the committed data.
+    SharedFifo::DataBlock inDataBlock;
+    ASSERT_NO_THROW(inDataBlock = producer.Reserve(2));
+    EXPECT_EQ(inDataBlock.sequence, 3);
+    inDataBlock.spans[0][0] = 3;
+    inDataBlock.spans[0][1] = 4;
+    ASSERT_NO_THROW(producer.Commit(2));
+
+    SharedFifo::DataBlock outDataBlock;
+    ASSERT_NO_THROW(outDataBlock = consumer.ReadBlock(5));
+    for (fifoDataType i = 0; i < 5; i++)
+    {
+        EXPECT_EQ(outDataBlock.spans[0][i], i);
+    }
+
+    producer.ReleaseProducer();
+    EXPECT_FALSE(consumer.ProducerAlive());
+}
+
+// Test that blocks peeked by a consumer that dies are delivered again to its replacement.
+TEST(SharedMemoryFifoTest, ConsumerRecovery)
+{
+    SharedFifo producer = SharedFifo::Create(10);
+    EXPECT_EQ(producer.AcquireProducer(), LeaseStatus::Acquired);
+    ASSERT_NO_THROW(producer.Reserve(6));
+    ASSERT_NO_THROW(producer.Commit(6));
+
+    const pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+
+    if (pid == 0)
+    {
+        SharedFifo consumer = SharedFifo::Attach(producer.Fd());
+        if (consumer.AcquireConsumer() != LeaseStatus::Acquired)
+        {
+            _exit(1);
+        }
+
+        // Release two elements and die holding a peek of three more.
+        consumer.PeekBlock(2);
+        consumer.Release(2);
+        consumer.PeekBlock(3);
+
+        _exit(0);
+    }
+
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+
+    EXPECT_FALSE(producer.ConsumerAlive());
+    EXPECT_EQ(producer.ReservableSize(), 6);
+
+    // Checking for a live consumer left the dead one's lease alone, so the replacement sees it was recovered.
+    SharedFifo consumer = SharedFifo::Attach(producer.Fd());
+    EXPECT_EQ(consumer.AcquireConsumer(), LeaseStatus::Recovered);
+    EXPECT_TRUE(producer.ConsumerAlive());
+    EXPECT_EQ(consumer.ReadableSize(), 4);
+
+    SharedFifo::DataBlock outDataBlock;
+    ASSERT_NO_THROW(outDataBlock = consumer.PeekBlock(4));
+    EXPECT_EQ(outDataBlock.sequence, 2);
+
+    // A second thread in this process cannot take a lease that is held.
+    std::thread other([&]()
+        {
+            SharedFifo otherConsumer = SharedFifo::Attach(producer.Fd());
+            EXPECT_EQ(otherConsumer.AcquireConsumer(), LeaseStatus::HeldByLiveOwner);
+        });
+    other.join();
+}
+
+// Test that a lease can only be released by the thread holding it.
+TEST(SharedMemoryFifoTest, LeaseThreadAffinity)
+{
+    SharedFifo producer = SharedFifo::Create(10);
+    SharedFifo consumer = SharedFifo::Attach(producer.Fd());
+    EXPECT_EQ(producer.AcquireProducer(), LeaseStatus::Acquired);
+    EXPECT_TRUE(consumer.ProducerAlive());
+
+    std::thread other([&]()
+        {
+            try
+            {
+                producer.ReleaseProducer();
+                ADD_FAILURE() << "Released a lease held by another thread";
+            }
+            catch (const std::system_error& error)
+            {
+                EXPECT_EQ(error.code(), std::errc::operation_not_permitted);
+            }
+        });
+    other.join();
+
+    // The lease is still held by this thread, which can release it.
+    EXPECT_TRUE(consumer.ProducerAlive());
+    ASSERT_NO_THROW(producer.ReleaseProducer());
+    EXPECT_FALSE(consumer.ProducerAlive());
+    EXPECT_EQ(consumer.AcquireProducer(), LeaseStatus::Acquired);
+}
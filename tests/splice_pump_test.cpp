@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <numeric>
+#include <system_error>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "splice_pump.h"
+
+using namespace FifoTemplates;
+
+typedef NoCopyRingFifo<std::byte> ByteFifo;
+
+namespace
+{
+    void Produce(ByteFifo& fifo, const std::vector<std::byte>& data, size_t& offset, size_t maxSize)
+    {
+        const size_t size = std::min({ fifo.ReservableSize(), maxSize, (data.size() - offset) });
+        auto dataBlock = fifo.Reserve(size);
+
+        for (const auto& span : dataBlock.spans)
+        {
+            std::copy_n((data.begin() + offset), span.size(), span.begin());
+            offset += span.size();
+        }
+
+        fifo.Commit(size);
+    }
+}
+
+// Spliced blocks stay peeked while the pipe still references them, and are released as they are read out of it.
+TEST(SplicePumpTest, PipeReferences)
+{
+    ByteFifo fifo(8192);
+    SplicePump pump(fifo);
+
+    auto dataBlock = fifo.Reserve(1000);
+    std::fill(dataBlock.spans[0].begin(), dataBlock.spans[0].end(), std::byte{ 'a' });
+    fifo.Commit(1000);
+
+    auto bytesSpliced = pump.Fill(600);
+    ASSERT_TRUE(bytesSpliced.has_value());
+    EXPECT_EQ(*bytesSpliced, 600);
+    EXPECT_EQ(pump.Pending(), 600);
+    EXPECT_EQ(fifo.ReleasableSize(), 600);
+    EXPECT_EQ(fifo.ReadableSize(), 400);
+    EXPECT_EQ(pump.Reclaim(), 0);
+
+    // The pipe refers to the FIFO's pages rather than a copy of them.
+    std::fill_n(dataBlock.spans[0].begin(), 600, std::byte{ 'b' });
+
+    std::vector<std::byte> received(250);
+    auto bytesRead = pump.Read(received);
+    ASSERT_TRUE(bytesRead.has_value());
+    EXPECT_EQ(*bytesRead, 250);
+    EXPECT_EQ(received[0], std::byte{ 'b' });
+    EXPECT_EQ(pump.Reclaim(), 0);
+    EXPECT_EQ(fifo.ReleasableSize(), 350);
+    EXPECT_EQ(fifo.ReservableSize(), (8192 - 750));
+
+    bytesSpliced = pump.Fill();
+    ASSERT_TRUE(bytesSpliced.has_value());
+    EXPECT_EQ(*bytesSpliced, 400);
+    EXPECT_EQ(pump.Pending(), 750);
+
+    received.resize(1000);
+    bytesRead = pump.Read(received);
+    ASSERT_TRUE(bytesRead.has_value());
+    EXPECT_EQ(*bytesRead, 750);
+    EXPECT_EQ(fifo.ReservableSize(), 8192);
+
+    bytesRead = pump.Read(received);
+    ASSERT_TRUE(bytesRead.has_value());
+    EXPECT_EQ(*bytesRead, 0);
+
+    auto emptyFill = pump.Fill();
+    ASSERT_TRUE(emptyFill.has_value());
+    EXPECT_EQ(*emptyFill, 0);
+}
+
+// Forward a stream into a file through a FIFO much smaller than the stream, wrapping around the buffer.
+TEST(SplicePumpTest, ForwardToFile)
+{
+    ByteFifo fifo(5000);
+    SplicePump pump(fifo);
+
+    std::vector<std::byte> data(100000);
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        data[i] = static_cast<std::byte>((i * 7) ^ (i >> 8));
+    }
+
+    const int fileFd = memfd_create("SplicePumpOut", MFD_CLOEXEC);
+    ASSERT_GE(fileFd, 0);
+
+    size_t produced = 0;
+    size_t forwarded = 0;
+    for (size_t pass = 0; forwarded < data.size(); pass++)
+    {
+        ASSERT_LT(pass, 10000);
+
+        if (produced < data.size())
+        {
+            Produce(fifo, data, produced, (((pass * 1237) % 3000) + 1));
+        }
+
+        auto bytesWritten = pump.Forward(fileFd, 2000);
+        ASSERT_TRUE(bytesWritten.has_value());
+        forwarded += *bytesWritten;
+    }
+
+    EXPECT_EQ(fifo.ReservableSize(), 5000);
+    EXPECT_EQ(pump.Pending(), 0);
+
+    std::vector<std::byte> copy(data.size());
+    ASSERT_EQ(pread(fileFd, copy.data(), copy.size(), 0), static_cast<ssize_t>(data.size()));
+    EXPECT_EQ(copy, data);
+
+    close(fileFd);
+}
+
+// Descriptors that would keep references to the pages are refused.
+TEST(SplicePumpTest, ForwardRefused)
+{
+    ByteFifo fifo(100);
+    SplicePump pump(fifo);
+
+    int pipeFds[2];
+    ASSERT_EQ(pipe(pipeFds), 0);
+    auto pipeResult = pump.Forward(pipeFds[1]);
+    ASSERT_FALSE(pipeResult.has_value());
+    EXPECT_EQ(pipeResult.error(), std::errc::invalid_argument);
+
+    int socketFds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, socketFds), 0);
+    auto socketResult = pump.Forward(socketFds[0]);
+    ASSERT_FALSE(socketResult.has_value());
+    EXPECT_EQ(socketResult.error(), std::errc::invalid_argument);
+
+    for (int fd : { pipeFds[0], pipeFds[1], socketFds[0], socketFds[1] })
+    {
+        close(fd);
+    }
+}
+
+// The pipe holds page references, so many small fills use it up, and Fill returns EAGAIN rather than blocking.
+TEST(SplicePumpTest, PipeFull)
+{
+    ByteFifo fifo(8192);
+    SplicePump pump(fifo);
+
+    fifo.Commit(fifo.Reserve(8192).size());
+
+    std::expected<size_t, std::error_code> bytesSpliced;
+    size_t fills = 0;
+    for (; fills < 8192; fills++)
+    {
+        bytesSpliced = pump.Fill(1);
+        if (!bytesSpliced.has_value())
+        {
+            break;
+        }
+    }
+
+    ASSERT_FALSE(bytesSpliced.has_value());
+    EXPECT_EQ(bytesSpliced.error(), std::errc::resource_unavailable_try_again);
+    EXPECT_GT(fills, 0);
+    EXPECT_LE(fills, (pump.PipeSize() / static_cast<size_t>(sysconf(_SC_PAGESIZE))));
+
+    // The refused byte is handed back, and reading the pipe makes room again.
+    EXPECT_EQ(fifo.ReleasableSize(), fills);
+    EXPECT_EQ(pump.Pending(), fills);
+
+    std::vector<std::byte> received(fills);
+    auto bytesRead = pump.Read(received);
+    ASSERT_TRUE(bytesRead.has_value());
+    EXPECT_EQ(*bytesRead, fills);
+    EXPECT_EQ(fifo.ReleasableSize(), 0);
+
+    bytesSpliced = pump.Fill(1);
+    ASSERT_TRUE(bytesSpliced.has_value());
+    EXPECT_EQ(*bytesSpliced, 1);
+}
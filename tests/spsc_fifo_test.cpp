@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <format>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "fifo_test_fixture.h"
+
+using namespace FifoTemplates;
+
+// Test filling and draining the FIFO one element at a time from a single thread.
+TEST_F(SpscFifoTest, ReserveWriteCommitReadSingle)
+{
+    fifo.Reset();
+
+    for (size_t i = 0; i < maxFifoSize; i++)
+    {
+        SCOPED_TRACE(std::format("Reserve loop iteration {}\r\n", i));
+
+        EXPECT_EQ(fifo.ReservableSize(), (maxFifoSize - i));
+
+        SpscNoCopyRingFifo<fifoDataType>::DataBlock inDataBlock;
+        ASSERT_NO_THROW(inDataBlock = fifo.Reserve(1));
+        EXPECT_EQ(inDataBlock.isValid(), true);
+        EXPECT_EQ(inDataBlock.isSplit(), false);
+
+        inDataBlock.spans[0][0] = i;
+    }
+
+    EXPECT_THROW(fifo.Reserve(1), std::overflow_error);
+    EXPECT_EQ(fifo.ReadableSize(), 0);
+
+    ASSERT_NO_THROW(fifo.Commit(maxFifoSize));
+    EXPECT_THROW(fifo.Commit(1), std::overflow_error);
+    EXPECT_EQ(fifo.ReadableSize(), maxFifoSize);
+
+    for (size_t i = 0; i < maxFifoSize; i++)
+    {
+        SCOPED_TRACE(std::format("Read loop iteration {}\r\n", i));
+
+        EXPECT_EQ(fifo.ReservableSize(), i);
+
+        SpscNoCopyRingFifo<fifoDataType>::DataBlock outDataBlock;
+        ASSERT_NO_THROW(outDataBlock = fifo.ReadBlock(1));
+        EXPECT_EQ(outDataBlock.spans[0][0], i);
+    }
+
+    EXPECT_THROW(fifo.ReadBlock(1), std::underflow_error);
+}
+
+// Test FIFO buffer wraparound for various block sizes.
+TEST_F(SpscFifoTest, Wraparound)
+{
+    for (size_t blockSize = 2; blockSize < maxFifoSize; blockSize++)
+    {
+        SCOPED_TRACE(std::format("Wraparound block loop iteration {}\r\n", blockSize));
+
+        fifo.Reset();
+
+        ASSERT_NO_THROW(fifo.Reserve(maxFifoSize - 1));
+        ASSERT_NO_THROW(fifo.Commit(maxFifoSize - 1));
+        ASSERT_NO_THROW(fifo.ReadBlock(maxFifoSize - 1));
+
+        SpscNoCopyRingFifo<fifoDataType>::DataBlock inDataBlock;
+        ASSERT_NO_THROW(inDataBlock = fifo.Reserve(blockSize));
+        EXPECT_EQ(inDataBlock.spans[0].size(), 1);
+        EXPECT_EQ(inDataBlock.spans[1].size(), (blockSize - 1));
+        EXPECT_EQ(inDataBlock.isSplit(), true);
+
+        ASSERT_NO_THROW(fifo.Commit(blockSize));
+        EXPECT_EQ(fifo.ReservableSize(), (maxFifoSize - blockSize));
+
+        SpscNoCopyRingFifo<fifoDataType>::DataBlock outDataBlock;
+        ASSERT_NO_THROW(outDataBlock = fifo.ReadBlock(blockSize));
+        EXPECT_EQ(outDataBlock.spans[0].data(), inDataBlock.spans[0].data());
+        EXPECT_EQ(outDataBlock.spans[1].data(), inDataBlock.spans[1].data());
+        EXPECT_EQ(outDataBlock.spans[1].size(), (blockSize - 1));
+        EXPECT_EQ(outDataBlock.sequence, (maxFifoSize - 1));
+        EXPECT_EQ(outDataBlock.sequence, inDataBlock.sequence);
+    }
+}
+
+// Move a counting sequence from a producer thread to a consumer thread and check it arrives intact, along with the
+// cursor accounting.  ReadBlock would free its block before the consumer could inspect it, so the consumer peeks and
+// releases instead.
+TEST_F(SpscFifoTest, ProducerConsumerThreads)
+{
+    constexpr size_t elementCount = 100000;
+
+    fifo.Reset();
+
+    std::thread producer([&]()
+        {
+            size_t produced = 0;
+            while (produced < elementCount)
+            {
+                const size_t blockSize = std::min({ fifo.ReservableSize(), ((produced % 3) + 1), (elementCount - produced) });
+                if (blockSize == 0)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                auto dataBlock = fifo.Reserve(blockSize);
+                for (auto& span : dataBlock.spans)
+                {
+                    for (auto& element : span)
+                    {
+                        element = static_cast<fifoDataType>(produced++);
+                    }
+                }
+                fifo.Commit(blockSize);
+            }
+        });
+
+    size_t consumed = 0;
+    bool sizeInRange = true;
+    bool inOrder = true;
+    while (consumed < elementCount)
+    {
+        const size_t readable = fifo.ReadableSize();
+        sizeInRange = sizeInRange && (readable <= maxFifoSize);
+        if (readable == 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        auto dataBlock = fifo.PeekBlock(readable);
+        sizeInRange = sizeInRange && ((dataBlock.spans[0].size() + dataBlock.spans[1].size()) == readable);
+        for (const auto& span : dataBlock.spans)
+        {
+            for (const auto& element : span)
+            {
+                inOrder = inOrder && (element == static_cast<fifoDataType>(consumed++));
+            }
+        }
+        fifo.Release(readable);
+    }
+
+    producer.join();
+
+    EXPECT_TRUE(sizeInRange);
+    EXPECT_TRUE(inOrder);
+    EXPECT_EQ(consumed, elementCount);
+    EXPECT_EQ(fifo.ReadableSize(), 0);
+    EXPECT_EQ(fifo.ReservableSize(), maxFifoSize);
+}
+
+// Stream a counting sequence from a producer thread to a consumer thread and check that it arrives intact.
+// The consumer holds each block with PeekBlock until it has checked the data, then releases it.
+TEST_F(SpscFifoTest, ProducerConsumerPeekRelease)
+{
+    constexpr fifoDataType elementCount = 100000;
+
+    fifo.Reset();
+
+    std::thread producer([&]()
+        {
+            fifoDataType next = 0;
+            while (next < elementCount)
+            {
+                const size_t blockSize = std::min<size_t>({ fifo.ReservableSize(), ((next % 3) + 1), (elementCount - next) });
+                if (blockSize == 0)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                auto dataBlock = fifo.Reserve(blockSize);
+                for (auto& span : dataBlock.spans)
+                {
+                    for (auto& element : span)
+                    {
+                        element = next++;
+                    }
+                }
+                fifo.Commit(blockSize);
+            }
+        });
+
+    fifoDataType expected = 0;
+    bool inOrder = true;
+    while (expected < elementCount)
+    {
+        const size_t readable = fifo.ReadableSize();
+        if (readable == 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        auto dataBlock = fifo.PeekBlock(readable);
+        for (auto& span : dataBlock.spans)
+        {
+            for (auto& element : span)
+            {
+                inOrder = inOrder && (element == expected);
+                expected++;
+            }
+        }
+        fifo.Release(readable);
+    }
+
+    producer.join();
+
+    EXPECT_TRUE(inOrder);
+    EXPECT_EQ(fifo.ReleasableSize(), 0);
+    EXPECT_EQ(fifo.ReservableSize(), maxFifoSize);
+}
+
+// Test that the blocking calls time out on a full or empty FIFO, and fail straight away for sizes that can never fit.
+TEST_F(SpscFifoTest, BlockingTimeout)
+{
+    using namespace std::chrono_literals;
+
+    fifo.Reset();
+
+    EXPECT_THROW(fifo.ReadBlock(1, 1ms), std::underflow_error);
+    EXPECT_EQ(fifo.TryPeekBlock(1, 1ms).error(), FifoError::InsufficientData);
+    EXPECT_THROW(fifo.Reserve(maxFifoSize + 1, waitForever), std::overflow_error);
+
+    ASSERT_NO_THROW(fifo.Reserve(maxFifoSize, 1ms));
+    ASSERT_NO_THROW(fifo.Commit(maxFifoSize));
+
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(fifo.TryReserve(1, 10ms).error(), FifoError::InsufficientSpace);
+    EXPECT_GE((std::chrono::steady_clock::now() - start), 10ms);
+
+    ASSERT_NO_THROW(fifo.ReadBlock(maxFifoSize, 1ms));
+}
+
+namespace
+{
+    // Stream a counting sequence between threads using only the blocking calls and return whether it arrived intact.
+    template <typename Fifo> bool StreamBlocking(Fifo& fifo, fifoDataType elementCount)
+    {
+        std::thread producer([&]()
+            {
+                fifoDataType next = 0;
+                while (next < elementCount)
+                {
+                    const size_t blockSize = std::min<size_t>(((next % 4) + 1), (elementCount - next));
+
+                    auto dataBlock = fifo.Reserve(blockSize, waitForever);
+                    for (auto& span : dataBlock.spans)
+                    {
+                        for (auto& element : span)
+                        {
+                            element = next++;
+                        }
+                    }
+                    fifo.Commit(blockSize);
+                }
+            });
+
+        fifoDataType expected = 0;
+        bool inOrder = true;
+        while (expected < elementCount)
+        {
+            const size_t blockSize = std::min<size_t>(((expected % 3) + 1), (elementCount - expected));
+
+            auto dataBlock = fifo.PeekBlock(blockSize, waitForever);
+            for (auto& span : dataBlock.spans)
+            {
+                for (auto& element : span)
+                {
+                    inOrder = inOrder && (element == expected);
+                    expected++;
+                }
+            }
+            fifo.Release(blockSize);
+        }
+
+        producer.join();
+
+        return inOrder;
+    }
+
+    template <typename WaitStrategy> void TestWaitStrategy(fifoDataType elementCount)
+    {
+        using namespace std::chrono_literals;
+
+        SpscNoCopyRingFifo<fifoDataType, DefaultErrorPolicy, WaitStrategy> fifo(10);
+
+        EXPECT_EQ(fifo.TryReadBlock(1, 1ms).error(), FifoError::InsufficientData);
+        EXPECT_TRUE(StreamBlocking(fifo, elementCount));
+        EXPECT_EQ(fifo.ReservableSize(), 10);
+    }
+}
+
+// Stream a counting sequence between threads using only the blocking calls, so both sides spend time waiting.
+// The default strategy polls, so this streams less data than the ParkWait case in SpscWaitStrategyTest.
+TEST_F(SpscFifoTest, BlockingThreads)
+{
+    fifo.Reset();
+
+    EXPECT_TRUE(StreamBlocking(fifo, 10000));
+    EXPECT_EQ(fifo.ReservableSize(), maxFifoSize);
+}
+
+// Test the blocking calls with each wait strategy.  The polling strategies can be very slow when the test threads
+// share a CPU, so they stream less data.
+TEST(SpscWaitStrategyTest, Strategies)
+{
+    {
+        SCOPED_TRACE("ParkWait");
+        TestWaitStrategy<ParkWait>(100000);
+    }
+    {
+        SCOPED_TRACE("SpinParkWait");
+        TestWaitStrategy<SpinParkWait<>>(100000);
+    }
+    {
+        SCOPED_TRACE("YieldWait");
+        TestWaitStrategy<YieldWait>(10000);
+    }
+    {
+        SCOPED_TRACE("SleepWait");
+        TestWaitStrategy<SleepWait<10>>(1000);
+    }
+    {
+        SCOPED_TRACE("BusySpinWait");
+        TestWaitStrategy<BusySpinWait>(1000);
+    }
+}
+
+// Test that up-to calls take what is available from the other side's latest cursor.
+TEST_F(SpscFifoTest, UpTo)
+{
+    fifo.Reset();
+
+    ASSERT_NO_THROW(fifo.Commit(fifo.ReserveUpTo(7).size()));
+    EXPECT_EQ(fifo.ReadableSize(), 7);
+    ASSERT_NO_THROW(fifo.ReadUpTo(5, 5));
+
+    SpscNoCopyRingFifo<fifoDataType>::DataBlock inDataBlock;
+    ASSERT_NO_THROW(inDataBlock = fifo.ReserveUpTo(SIZE_MAX, 0, UpTo::Contiguous));
+    EXPECT_EQ(inDataBlock.size(), 3);
+    ASSERT_NO_THROW(inDataBlock = fifo.ReserveUpTo(SIZE_MAX));
+    EXPECT_EQ(inDataBlock.size(), 5);
+    EXPECT_EQ(fifo.TryReserveUpTo(1, 1).error(), FifoError::InsufficientSpace);
+    ASSERT_NO_THROW(fifo.Commit(8));
+
+    SpscNoCopyRingFifo<fifoDataType>::DataBlock outDataBlock;
+    ASSERT_NO_THROW(outDataBlock = fifo.PeekUpTo(SIZE_MAX, 0, UpTo::Contiguous));
+    EXPECT_EQ(outDataBlock.size(), 5);
+    EXPECT_THROW(fifo.ReadUpTo(SIZE_MAX), std::logic_error);
+    ASSERT_NO_THROW(fifo.Release(5));
+    EXPECT_THROW(fifo.ReadUpTo(SIZE_MAX, 6), std::underflow_error);
+    ASSERT_NO_THROW(outDataBlock = fifo.ReadUpTo(SIZE_MAX));
+    EXPECT_EQ(outDataBlock.size(), 5);
+    EXPECT_EQ(fifo.ReservableSize(), maxFifoSize);
+}